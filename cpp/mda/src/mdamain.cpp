@@ -22,6 +22,9 @@
 #include <QJsonObject>
 #include <diskreadmda.h>
 #include "diskwritemda.h"
+#include "mdastats.h"
+#include "mdaio.h"
+#include "get_sort_indices.h"
 
 void print_usage();
 
@@ -183,6 +186,64 @@ int main(int argc, char* argv[])
 
         return 0;
     }
+    else if (arg1 == "stats") {
+        if (arg2.isEmpty()) {
+            print_usage();
+            return -1;
+        }
+        if (!QFile::exists(arg2)) {
+            printf("Input file does not exist.\n");
+            return -1;
+        }
+        MdaStatistics S;
+        if (params.named_parameters.contains("quantiles")) {
+            QVector<double> probabilities;
+            QStringList vals = params.named_parameters["quantiles"].toString().split(",", QString::SkipEmptyParts);
+            foreach (QString val, vals) {
+                probabilities << val.toDouble();
+            }
+            S.setQuantileProbabilities(probabilities);
+        }
+        if (params.named_parameters.contains("compression"))
+            S.setCompression(params.named_parameters["compression"].toDouble());
+        if (params.named_parameters.contains("threads"))
+            S.setNumThreads(params.named_parameters["threads"].toInt());
+        DiskReadMda X(arg2);
+        if (!S.compute(X)) {
+            printf("Problem reading array.\n");
+            return -1;
+        }
+        QJsonObject obj = S.toJsonObject(params.named_parameters.contains("per_channel"));
+        printf("%s\n", QJsonDocument(obj).toJson(QJsonDocument::Indented).data());
+        return 0;
+    }
+    else if (arg1 == "unit_test") {
+        diskreadmda_unit_test();
+        if (!mdastats_unit_test())
+            return -1;
+        return 0;
+    }
+    else if (arg1 == "bench_hash") {
+        if (!QFile::exists(arg2)) {
+            printf("Input file does not exist.\n");
+            return -1;
+        }
+        MLUtil::benchmarkSha1SumOfFile(arg2, params.named_parameters.value("passes", 3).toInt());
+        return 0;
+    }
+    else if (arg1 == "bench_compute") {
+        MLCompute::benchmark(params.named_parameters.value("size", 100000000).toLongLong());
+        return 0;
+    }
+    else if (arg1 == "bench_convert") {
+        mda_convert_benchmark(params.named_parameters.value("size", 10000000).toLongLong());
+        return 0;
+    }
+    else if (arg1 == "bench_sort") {
+        bigint max_size = params.named_parameters.value("max_size", 1000000000).toLongLong();
+        get_sort_indices_benchmark(max_size);
+        return 0;
+    }
     else {
         qInstallMessageHandler(silent_message_output);
         DiskReadMda X(arg1);
@@ -301,6 +362,12 @@ void print_usage()
     printf("mda get_chunk file.mda chunk_out.mda --index=0,100 --size=4x50\n");
     printf("mda create file.mda --dtype=int16 --size=4x1000\n");
     printf("mda set_chunk target_file.mda chunk.mda --index=0,100\n");
+    printf("mda stats file.mda [--per_channel] [--quantiles=0.01,0.5,0.99] [--compression=100] [--threads=8]\n");
+    printf("mda unit_test (writes temporary files to the current directory)\n");
+    printf("mda bench_hash file [--passes=3]\n");
+    printf("mda bench_compute [--size=100000000]\n");
+    printf("mda bench_convert [--size=10000000]\n");
+    printf("mda bench_sort [--max_size=1000000000]\n");
     /*
     printf("Example usages for converting between raw and mda formats:\n");
     printf("mdaconvert input.mda\n");
@@ -28,4 +28,7 @@ QList<bigint> get_sort_indices_bigint(const QVector<double>& X);
 
 MLVector<bigint> get_sort_indices(const MLVector<double>& X);
 
+//prints the time taken by get_sort_indices and by an argsort with std::stable_sort (the previous implementation) for random arrays of 1e3, 1e4, ..., max_size entries
+void get_sort_indices_benchmark(bigint max_size = 1000000000);
+
 #endif // GET_SORT_INDICES_H
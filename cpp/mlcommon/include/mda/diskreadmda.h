@@ -18,13 +18,17 @@
 #define DISKREADMDA_H
 
 #include "mda.h"
+#include "mda32.h"
 #include "mdaio.h"
+#include "mdaview.h"
 
 class DiskReadMdaPrivate;
 /**
  * \class DiskReadMda
  * @brief Read-only access to a .mda file, especially useful for huge arrays that cannot be practically loaded into memory.
  *
+ * The const methods (readChunk(), value(), etc) may be called concurrently from several threads on the same object. The file is opened once and read with pread, so a worker pool can share one DiskReadMda without reopening the file per thread. The non-const methods (setPath(), reshape(), setUseMmap(), etc) must not run concurrently with anything else.
+ *
  * See also Mda
  */
 class DiskReadMda {
@@ -34,8 +38,8 @@ public:
     DiskReadMda(const DiskReadMda& other); ///Copy constructor
     DiskReadMda(const Mda& X); ///Constructor based on an in-memory array. This enables passing an Mda into a function that expects a DiskReadMda.
     DiskReadMda(const QJsonObject& prv_object);
-    DiskReadMda(int concat_dimension, const QList<DiskReadMda>& arrays); //concatenation of arrays. For now concat_dimension must be 2
-    DiskReadMda(int concat_dimension, const QStringList& array_paths); //concatenation of arrays. For now concat_dimension must be 2
+    DiskReadMda(int concat_dimension, const QList<DiskReadMda>& arrays); //virtual concatenation of arrays along concat_dimension (1-based). The arrays must agree in all other dimensions
+    DiskReadMda(int concat_dimension, const QStringList& array_paths); //virtual concatenation of arrays along concat_dimension (1-based). The arrays must agree in all other dimensions
     virtual ~DiskReadMda();
     void operator=(const DiskReadMda& other);
 
@@ -45,6 +49,14 @@ public:
     void setConcatPaths(int concat_dimension, const QStringList& paths);
     void setConcatDirectory(int concat_dimension, const QString& dir_path);
 
+    ///Serve reads directly from a read-only memory mapping of the file rather than through stdio. Falls back to buffered reads if the file cannot be mapped. Note that mapped pages count towards the resident memory of the process.
+    void setUseMmap(bool val);
+    bool useMmap() const;
+
+    ///Set the maximum number of bytes used by value() to cache recently used blocks of the array (default 8 MB). Cache hits, misses and evictions are reported through the diskreadmda_cache_* counters of the ICounterManager, if present.
+    void setValueCacheSize(bigint num_bytes);
+    bigint valueCacheSize() const;
+
     QString makePath() const; //not capturing the reshaping
     QJsonObject toPrvObject() const;
 
@@ -69,6 +81,43 @@ public:
     bool readChunk(Mda& X, bigint i1, bigint i2, bigint size1, bigint size2) const;
     ///Retrieve a chunk of the vectorized data of size N1xN2xN3 starting at position (i1,i2,i3)
     bool readChunk(Mda& X, bigint i1, bigint i2, bigint i3, bigint size1, bigint size2, bigint size3) const;
+    ///Same as above, but retrieving 32-bit floats without going through a float64 buffer
+    bool readChunk(Mda32& X, bigint i, bigint size) const;
+    bool readChunk(Mda32& X, bigint i1, bigint i2, bigint size1, bigint size2) const;
+    bool readChunk(Mda32& X, bigint i1, bigint i2, bigint i3, bigint size1, bigint size2, bigint size3) const;
+
+    ///Retrieve size entries of the vectorized data starting at position i into a caller-provided buffer of type data_type (one of the MDAIO_TYPE_* codes). No conversion takes place when data_type is the file's own type (see mdaioHeader().data_type). Entries outside the array are set to zero.
+    bool readRawChunk(void* data, int data_type, bigint i, bigint size) const;
+    ///Retrieve the hyper-rectangle of size size[0]x...xsize[ndims-1] starting at position (start[0],...,start[ndims-1]) into a caller-provided buffer of type data_type, with ndims between 1 and 6. The last of the ndims dimensions spans all remaining dimensions of the array, so ndims=1 refers to the vectorized data. Entries outside the array are set to zero.
+    bool readRawChunk(void* data, int data_type, int ndims, const bigint* start, const bigint* size) const;
+    ///Fill the view X with the vectorized data starting at position i, in the view's own type. For example, readChunk(MdaView<int16_t>(buf, N1(), 1000), N1() * t0) reads 1000 timepoints of an int16 recording as int16
+    template <typename T>
+    bool readChunk(const MdaView<T>& X, bigint i) const
+    {
+        return readRawChunk(X.data(), X.dataType(), i, X.totalSize());
+    }
+    ///Fill the view X with the hyper-rectangle of the same dimensions starting at position (i1,...,i6), in the view's own type
+    template <typename T>
+    bool readChunk(const MdaView<T>& X, bigint i1, bigint i2, bigint i3 = 0, bigint i4 = 0, bigint i5 = 0, bigint i6 = 0) const
+    {
+        bigint start[6] = { i1, i2, i3, i4, i5, i6 };
+        bigint size[6] = { X.N1(), X.N2(), X.N3(), X.N4(), X.N5(), X.N6() };
+        return readRawChunk(X.data(), X.dataType(), 6, start, size);
+    }
+    ///Zero-copy view of size entries of the vectorized data starting at position i. This is only possible when useMmap() is set, T is the file's own type and the mapped data is aligned for T (the data starts right after the header, so for example a float64 file with an odd number of 32-bit dimensions is not); otherwise (or if the range is out of bounds) a null view is returned and readChunk() should be used instead.
+    template <typename T>
+    MdaView<const T> chunkView(bigint i, bigint size) const
+    {
+        if ((mdaioHeader().data_type != MdaDataType<T>::value) || (i < 0) || (size <= 0) || (i + size > totalSize()))
+            return MdaView<const T>();
+        const void* ptr = mappedDataPtr(i);
+        if ((!ptr) || ((uintptr_t)ptr % alignof(T) != 0))
+            return MdaView<const T>();
+        return MdaView<const T>((const T*)ptr, size, 1);
+    }
+
+    ///Zero-copy access to the raw entries (stored in the file's data type, see mdaioHeader().data_type) starting at position i of the vectorized array. Only available when useMmap() is set, otherwise returns 0. The pointer need not be aligned for the data type, so read the entries with memcpy. The pointer remains valid until the path is changed or mmap is disabled.
+    const void* mappedDataPtr(bigint i = 0) const;
 
     ///A slow method to retrieve the value at location i of the vectorized array for example value(3+4*N1())==value(3,4). Consider using readChunk() instead
     double value(bigint i) const;
@@ -81,6 +130,42 @@ private:
     DiskReadMdaPrivate* d;
 };
 
+class DiskReadMdaChunkIteratorPrivate;
+/**
+ * \class DiskReadMdaChunkIterator
+ * @brief Sequential scan over a DiskReadMda in chunks along the last dimension, reading ahead on a background thread
+ *
+ * The array is treated as N1 x M where M=totalSize()/N1 (for example channels x timepoints). Each chunk covers chunk_size columns, padded by overlap columns on each side (zeros beyond the ends of the array), so filters have the margins they need. While the caller processes the current chunk, up to num_prefetch further chunks are read in the background, so disk and compute overlap. At most num_prefetch+1 chunks are held in memory.
+ *
+ * \code
+ * DiskReadMdaChunkIterator it(X, 100000, 1000);
+ * while (it.next()) {
+ *     const Mda& chunk = it.chunk(); // N1 x (chunkSize()+2*overlap()), starting at column chunkStart()-overlap()
+ * }
+ * \endcode
+ */
+class DiskReadMdaChunkIterator {
+public:
+    friend class DiskReadMdaChunkIteratorPrivate;
+    DiskReadMdaChunkIterator(const DiskReadMda& X, bigint chunk_size, bigint overlap = 0, int num_prefetch = 2);
+    virtual ~DiskReadMdaChunkIterator();
+
+    ///Advance to the next chunk, waiting for it if it has not been read yet. Returns false when there are no more chunks or a read failed
+    bool next();
+    ///The current chunk, of size N1 x (chunkSize()+2*overlap())
+    const Mda& chunk() const;
+    ///The first column of the current chunk, not counting the overlap
+    bigint chunkStart() const;
+    ///The number of columns of the current chunk, not counting the overlap. This is less than the requested chunk size for the final chunk
+    bigint chunkSize() const;
+    bigint overlap() const;
+
+private:
+    DiskReadMdaChunkIteratorPrivate* d;
+    DiskReadMdaChunkIterator(const DiskReadMdaChunkIterator&);
+    void operator=(const DiskReadMdaChunkIterator&);
+};
+
 ///Unit test
 void diskreadmda_unit_test();
 
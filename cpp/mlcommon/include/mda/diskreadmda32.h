@@ -34,8 +34,8 @@ public:
     DiskReadMda32(const DiskReadMda32& other); ///Copy constructor
     DiskReadMda32(const Mda32& X); ///Constructor based on an in-memory array. This enables passing an Mda32 into a function that expects a DiskReadMda32.
     DiskReadMda32(const QJsonObject& prv_object);
-    DiskReadMda32(int concat_dimension, const QList<DiskReadMda32>& arrays); //concatenation of arrays. For now concat_dimension must be 2
-    DiskReadMda32(int concat_dimension, const QStringList& array_paths); //concatenation of arrays. For now concat_dimension must be 2
+    DiskReadMda32(int concat_dimension, const QList<DiskReadMda32>& arrays); //virtual concatenation of arrays along concat_dimension (1-based). The arrays must agree in all other dimensions
+    DiskReadMda32(int concat_dimension, const QStringList& array_paths); //virtual concatenation of arrays along concat_dimension (1-based). The arrays must agree in all other dimensions
     virtual ~DiskReadMda32();
     void operator=(const DiskReadMda32& other);
 
@@ -24,6 +24,12 @@
 #include <mdaio.h>
 
 class DiskWriteMdaPrivate;
+/**
+ * \class DiskWriteMda
+ * @brief Write access to a .mda file, chunk by chunk, for arrays too large to hold in memory
+ *
+ * Chunks are written with pwrite at their own position in the file, so several threads may call writeChunk() at the same time as long as they fill disjoint regions. By default each writeChunk() converts and writes on the calling thread. After setNumWriteThreads(n) with n>0, writeChunk() instead queues the chunk and returns at once, and n worker threads convert and write it. The queue is bounded by setMaxPendingBytes(), so a producer that outpaces the disk will block. Use flush() to wait for the queued chunks, and sync() to also force them to disk.
+ */
 class DiskWriteMda {
 public:
     friend class DiskWriteMdaPrivate;
@@ -32,8 +38,22 @@ public:
     virtual ~DiskWriteMda();
     bool open(int data_type, const QString& path, bigint N1, bigint N2, bigint N3 = 1, bigint N4 = 1, bigint N5 = 1, bigint N6 = 1);
     bool open(const QString& path);
+    ///Waits for any queued chunks, then closes (and renames) the file. Call flush() first if you need to know whether the queued writes succeeded
     void close();
 
+    ///Number of threads converting and writing queued chunks in the background (default 0, meaning writeChunk() writes synchronously)
+    void setNumWriteThreads(int num);
+    ///Maximum number of bytes held by queued chunks before writeChunk() blocks (default 256 MB)
+    void setMaxPendingBytes(bigint num_bytes);
+    ///Reserve the disk space for the whole array when a new file is opened (posix_fallocate on Linux), rather than creating a sparse file. This avoids fragmentation and reports a full disk up front
+    void setPreallocate(bool val);
+    ///Force the data to disk with fsync before the file is closed
+    void setSyncOnClose(bool val);
+    ///Wait until all queued chunks have been written. Returns false if any write has failed since the file was opened
+    bool flush();
+    ///Same as flush(), followed by fsync
+    bool sync();
+
     bigint N1();
     bigint N2();
     bigint N3();
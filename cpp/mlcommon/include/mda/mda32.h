@@ -23,8 +23,10 @@
 #endif
 
 #include "mlcommon.h"
+#include "mdaview.h"
 
 typedef float dtype32;
+typedef MdaView<dtype32> Mda32View;
 
 extern void* allocate(const bigint nbytes);
 
@@ -45,10 +47,16 @@ public:
     Mda32(const Mda32& other);
     ///Assignment operator
     void operator=(const Mda32& other);
+    ///Move constructor. other is left empty
+    Mda32(Mda32&& other);
+    ///Move assignment. Unlike a copy, this never leaves the data shared, so a later write cannot trigger a deep copy
+    void operator=(Mda32&& other);
     ///Destructor
     virtual ~Mda32();
-    ///Allocate an array of size N1xN2x...xN6
+    ///Allocate an array of size N1xN2x...xN6. Returns false, leaving an empty array, if the memory is not available or MdaMemoryBudget refuses it
     bool allocate(bigint N1, bigint N2, bigint N3 = 1, bigint N4 = 1, bigint N5 = 1, bigint N6 = 1);
+    ///Same as allocate(), but without setting the entries to zero. Use this when every entry is about to be overwritten, for example by DiskReadMda::readChunk(), to avoid an extra pass over (and page-faulting) the whole buffer. If the total size is unchanged the existing buffer is reused
+    bool allocateUninitialized(bigint N1, bigint N2, bigint N3 = 1, bigint N4 = 1, bigint N5 = 1, bigint N6 = 1);
 #ifdef QT_CORE_LIB
     ///Create an array with content read from the .mda file specified by path
     bool read(const QString& path);
@@ -132,6 +140,10 @@ public:
     ///Return a pointer to the 1D raw data. The internal data may be efficiently read/written.
     dtype32* dataPtr();
     const dtype32* constDataPtr() const;
+    ///A non-owning view of the whole array, for example to pass to DiskReadMda::readChunk(). The view is only valid while this array is alive and not reallocated. As with dataPtr(), the array is first detached if it is shared
+    MdaView<dtype32> view();
+    ///A read-only non-owning view of the whole array. This never copies the data
+    MdaView<const dtype32> constView() const;
     ///Return a pointer to the 1D raw data at the vectorized location i. The internal data may be efficiently read/written.
     dtype32* dataPtr(bigint i);
     ///Return a pointer to the 1D raw data at the the location (i1,i2). The internal data may be efficiently read/written.
@@ -147,6 +159,10 @@ public:
     void getChunk(Mda32& ret, bigint i1, bigint i2, bigint N1, bigint N2) const;
     ///Retrieve a chunk of the vectorized data of size N1xN2xN3 starting at position (i1,i2,i3)
     void getChunk(Mda32& ret, bigint i1, bigint i2, bigint i3, bigint size1, bigint size2, bigint size3) const;
+    ///Same as above, but filling a caller-provided buffer (of size ret.totalSize(), ret.N1()xret.N2(), or ret.N1()xret.N2()xret.N3() respectively) rather than allocating a new array. Entries outside this array are set to zero
+    void getChunk(const MdaView<dtype32>& ret, bigint i) const;
+    void getChunk(const MdaView<dtype32>& ret, bigint i1, bigint i2) const;
+    void getChunk(const MdaView<dtype32>& ret, bigint i1, bigint i2, bigint i3) const;
 
     ///Set a chunk of the vectorized data starting at position i
     void setChunk(Mda32& X, bigint i);
@@ -21,9 +21,33 @@
 #include <objectregistry.h>
 #include <cstring>
 #include "mlcommon.h"
+#include "mdabufferpool.h"
+#include "mdamemorybudget.h"
 
 #define MDA_MAX_DIMS 6
 
+///Copy the size1xsize2xsize3 block starting at (i1,i2,i3) of the M1xM2xM3 array src into dst, setting the entries that fall outside src to zero. This is the common implementation of getChunk()
+template <typename T>
+void mda_copy_chunk(T* dst, bigint size1, bigint size2, bigint size3, const T* src, bigint M1, bigint M2, bigint M3, bigint i1, bigint i2, bigint i3)
+{
+    bigint a1 = qMax(i1, (bigint)0), b1 = qMin(i1 + size1, M1);
+    bigint a2 = qMax(i2, (bigint)0), b2 = qMin(i2 + size2, M2);
+    bigint a3 = qMax(i3, (bigint)0), b3 = qMin(i3 + size3, M3);
+    if ((a1 >= b1) || (a2 >= b2) || (a3 >= b3)) {
+        std::memset(dst, 0, size1 * size2 * size3 * sizeof(T));
+        return;
+    }
+    if ((a1 != i1) || (b1 != i1 + size1) || (a2 != i2) || (b2 != i2 + size2) || (a3 != i3) || (b3 != i3 + size3))
+        std::memset(dst, 0, size1 * size2 * size3 * sizeof(T));
+    for (bigint j3 = a3; j3 < b3; j3++) {
+        for (bigint j2 = a2; j2 < b2; j2++) {
+            const T* ptr_in = src + a1 + M1 * (j2 + M2 * j3);
+            T* ptr_out = dst + (a1 - i1) + size1 * ((j2 - i2) + size2 * (j3 - i3));
+            std::copy(ptr_in, ptr_in + (b1 - a1), ptr_out);
+        }
+    }
+}
+
 template <typename T>
 class MdaData : public QSharedData {
 public:
@@ -31,11 +55,12 @@ public:
     typedef T* pointer;
     typedef T& reference;
 
-    MdaData()
+    MdaData(const char* budget_subsystem = "mda")
         : QSharedData()
         , m_data(0)
         , m_dims(1, 1)
         , total_size(0)
+        , m_budget_subsystem(budget_subsystem)
     {
         ICounterManager* manager = ObjectRegistry::getObject<ICounterManager>();
         if (manager) {
@@ -50,12 +75,21 @@ public:
         , m_data(0)
         , m_dims(other.m_dims)
         , total_size(other.total_size)
+        , m_budget_subsystem(other.m_budget_subsystem)
         , allocatedCounter(other.allocatedCounter)
         , freedCounter(other.freedCounter)
         , bytesReadCounter(other.bytesReadCounter)
         , bytesWrittenCounter(other.bytesWrittenCounter)
     {
-        allocate(total_size);
+        //a detach has no way to report failure, so the copy is charged to the budget regardless of the limit
+        if (total_size > 0) {
+            MdaMemoryBudget::charge(total_size * sizeof(value_type), m_budget_subsystem);
+            m_data = (value_type*)MdaBufferPool::allocate(total_size * sizeof(value_type));
+            if (!m_data) {
+                qCritical() << QString("Unable to allocate copy of Mda (total=%1)").arg(total_size);
+                exit(-1);
+            }
+        }
         std::copy(other.m_data, other.m_data + other.totalSize(), m_data);
     }
     ~MdaData()
@@ -64,19 +98,9 @@ public:
     }
     bool allocate(T value, bigint N1, bigint N2, bigint N3 = 1, bigint N4 = 1, bigint N5 = 1, bigint N6 = 1)
     {
-        deallocate();
-        setDims(N1, N2, N3, N4, N5, N6);
-        if (N1 > 0 && N2 > 0 && N3 > 0 && N4 > 0 && N5 > 0 && N6 > 0)
-            setTotalSize(N1 * N2 * N3 * N4 * N5 * N6);
-        else
-            setTotalSize(0);
-
+        if (!allocateUninitialized(N1, N2, N3, N4, N5, N6))
+            return false;
         if (totalSize() > 0) {
-            allocate(totalSize());
-            if (!constData()) {
-                qCritical() << QString("Unable to allocate Mda of size %1x%2x%3x%4x%5x%6 (total=%7)").arg(N1).arg(N2).arg(N3).arg(N4).arg(N5).arg(N6).arg(totalSize());
-                exit(-1);
-            }
             if (value == 0.0) {
                 std::memset(data(), 0, totalSize() * sizeof(value_type));
             }
@@ -85,25 +109,55 @@ public:
         }
         return true;
     }
+    ///Same as allocate(), but leaving the contents undefined, for callers that are about to overwrite every entry. The existing buffer is kept if the total size is unchanged
+    bool allocateUninitialized(bigint N1, bigint N2, bigint N3 = 1, bigint N4 = 1, bigint N5 = 1, bigint N6 = 1)
+    {
+        bigint new_total_size = 0;
+        if (N1 > 0 && N2 > 0 && N3 > 0 && N4 > 0 && N5 > 0 && N6 > 0)
+            new_total_size = N1 * N2 * N3 * N4 * N5 * N6;
+        if ((m_data) && (new_total_size == totalSize())) {
+            setDims(N1, N2, N3, N4, N5, N6);
+            return true;
+        }
+        deallocate();
+        setDims(N1, N2, N3, N4, N5, N6);
+        setTotalSize(new_total_size);
+
+        if (totalSize() > 0) {
+            if (!allocate(totalSize())) {
+                qWarning() << QString("Unable to allocate Mda of size %1x%2x%3x%4x%5x%6 (total=%7)").arg(N1).arg(N2).arg(N3).arg(N4).arg(N5).arg(N6).arg(totalSize());
+                //leave a consistent empty array behind
+                setDims(0, 0, 1, 1, 1, 1);
+                setTotalSize(0);
+                return false;
+            }
+        }
+        return true;
+    }
 
     inline bigint dim(bigint idx) const { return m_dims.at(idx); }
     inline bigint N1() const { return dim(0); }
     inline bigint N2() const { return dim(1); }
 
-    void allocate(bigint size)
+    bool allocate(bigint size)
     {
-        //m_data = (value_type*)::allocate(size * sizeof(value_type));
-        m_data = (value_type*)malloc(size * sizeof(value_type));
-        if (!m_data)
-            return;
-        incrementBytesAllocatedCounter(totalSize() * sizeof(value_type));
+        //charged to the memory budget (failing or waiting according to the policy of the calling thread); buffers come from the per-thread pool, which reports to the allocated_bytes/freed_bytes counters when it has to go to the system
+        bigint num_bytes = size * sizeof(value_type);
+        if (!MdaMemoryBudget::acquire(num_bytes, m_budget_subsystem))
+            return false;
+        m_data = (value_type*)MdaBufferPool::allocate(num_bytes);
+        if (!m_data) {
+            MdaMemoryBudget::release(num_bytes, m_budget_subsystem);
+            return false;
+        }
+        return true;
     }
     void deallocate()
     {
         if (!m_data)
             return;
-        free(m_data);
-        incrementBytesFreedCounter(totalSize() * sizeof(value_type));
+        MdaBufferPool::release(m_data, totalSize() * sizeof(value_type));
+        MdaMemoryBudget::release(totalSize() * sizeof(value_type), m_budget_subsystem);
         m_data = 0;
     }
     inline bigint totalSize() const { return total_size; }
@@ -260,6 +314,7 @@ private:
     pointer m_data;
     std::vector<bigint> m_dims;
     bigint total_size;
+    const char* m_budget_subsystem; //name under which the buffer is charged to MdaMemoryBudget
     mutable IIntCounter* allocatedCounter = nullptr;
     mutable IIntCounter* freedCounter = nullptr;
     mutable IIntCounter* bytesReadCounter = nullptr;
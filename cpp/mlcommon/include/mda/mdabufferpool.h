@@ -0,0 +1,84 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MDABUFFERPOOL_H
+#define MDABUFFERPOOL_H
+
+#include <stdint.h>
+
+typedef int64_t bigint;
+
+#define MDA_BUFFER_ALIGNMENT 64
+
+/** \class MdaBufferPool - per-thread cache of released array buffers, grouped in size classes
+ * @brief The MdaBufferPool class
+ *
+ * Mda, Mda32 and the temporary buffers of DiskReadMda take their memory from here. A released buffer is kept in a small cache belonging to the releasing thread and handed out again for the next request of the same size class (sizes are rounded up to the next multiple of a quarter power of two, so at most 25% is wasted). Chunked processing loops therefore stop calling malloc and free once the first chunk has been processed.
+ *
+ * Buffers that do not fit in the cache of the releasing thread go to a cache shared by all threads, which is consulted (under a lock) when the cache of the allocating thread has nothing suitable. That way a buffer allocated by one thread and released by another, as with a reading thread feeding a processing thread, is still reused. Both caches are bounded (by default 4 MB per thread and 64 MB shared); anything beyond is returned to the system right away. Cached buffers are not charged to MdaMemoryBudget, so the bounds are kept small.
+ *
+ * All buffers are aligned to MDA_BUFFER_ALIGNMENT (64) bytes, and buffers for huge pages (see setUseHugePages()) to the huge page size. Only memory actually obtained from or returned to the system is reported through the allocated_bytes and freed_bytes counters; requests served from the cache are reported through mda_pool_hits and mda_pool_misses.
+ */
+class MdaBufferPool {
+public:
+    ///Returns an aligned buffer of at least num_bytes bytes, or 0 if num_bytes is zero or the memory is not available
+    static void* allocate(bigint num_bytes);
+    ///Give back a buffer obtained from allocate(). num_bytes must be the size that was requested
+    static void release(void* ptr, bigint num_bytes);
+
+    ///Set the maximum number of bytes kept in the cache of the calling thread (0 disables caching for this thread)
+    static void setThreadCacheSize(bigint num_bytes);
+    static bigint threadCacheSize();
+    ///Set the cache size for threads that have not called setThreadCacheSize() (default 4 MB)
+    static void setDefaultThreadCacheSize(bigint num_bytes);
+    ///Free all buffers in the cache of the calling thread
+    static void clearThreadCache();
+    ///Set the maximum number of bytes kept in the cache shared by all threads (default 64 MB, 0 disables it)
+    static void setSharedCacheSize(bigint num_bytes);
+    static bigint sharedCacheSize();
+    ///Free all buffers in the shared cache
+    static void clearSharedCache();
+    ///The number of bytes held in the cache of the calling thread and in the shared cache
+    static bigint cachedBytes();
+
+    ///Back buffers of at least 2 MB with transparent huge pages (madvise MADV_HUGEPAGE, Linux only), which reduces TLB misses when scanning large in-memory arrays. Off by default, since it can raise memory usage
+    static void setUseHugePages(bool val);
+    static bool useHugePages();
+};
+
+/** \class MdaPooledBuffer - a scratch buffer drawn from MdaBufferPool, released on destruction
+ *
+ * If budget_subsystem is given, the buffer is charged to MdaMemoryBudget under that name, and resize() fails when the budget is exceeded.
+ */
+class MdaPooledBuffer {
+public:
+    MdaPooledBuffer(bigint num_bytes = 0, const char* budget_subsystem = 0);
+    ~MdaPooledBuffer();
+    ///Make the buffer at least num_bytes long. The contents are not preserved
+    bool resize(bigint num_bytes);
+    char* data() const { return m_data; }
+    bigint size() const { return m_size; }
+
+private:
+    char* m_data;
+    bigint m_size;
+    const char* m_budget_subsystem;
+    void free_data();
+    MdaPooledBuffer(const MdaPooledBuffer&);
+    void operator=(const MdaPooledBuffer&);
+};
+
+#endif // MDABUFFERPOOL_H
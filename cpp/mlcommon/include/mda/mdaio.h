@@ -100,6 +100,29 @@ bigint mda_write_uint16(uint16_t* data, struct MDAIO_HEADER* H, bigint n, FILE*
 bigint mda_write_float64(double* data, struct MDAIO_HEADER* H, bigint n, FILE* output_file);
 bigint mda_write_uint32(uint32_t* data, struct MDAIO_HEADER* H, bigint n, FILE* output_file);
 
+//the following convert n entries stored in the file's data type (for example in a memory-mapped file) to the chosen type
+bigint mda_convert_byte(unsigned char* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer);
+bigint mda_convert_float32(float* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer);
+bigint mda_convert_int16(int16_t* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer);
+bigint mda_convert_int32(int32_t* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer);
+bigint mda_convert_uint16(uint16_t* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer);
+bigint mda_convert_float64(double* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer);
+bigint mda_convert_uint32(uint32_t* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer);
+
+//the following read or convert n entries to the type given by data_type (one of the MDAIO_TYPE_* codes), with data pointing to a buffer of that type
+bigint mda_read_data(void* data, int data_type, struct MDAIO_HEADER* H, bigint n, FILE* input_file);
+bigint mda_convert_data(void* data, int data_type, struct MDAIO_HEADER* H, bigint n, const void* input_buffer);
+//same as mda_read_data, but reading at the given byte offset of the file descriptor with pread, so that several threads can share one descriptor
+bigint mda_pread_data(void* data, int data_type, struct MDAIO_HEADER* H, bigint n, int fd, bigint offset);
+//write n entries of type data_type, converted to the file's data type H->data_type, at the given byte offset of the file descriptor with pwrite, so that several threads can fill disjoint regions of one file
+bigint mda_pwrite_data(const void* data, int data_type, struct MDAIO_HEADER* H, bigint n, int fd, bigint offset);
+
+//the number of bytes per entry for the data type, or 0 if the data type is not supported
+int mda_get_num_bytes_per_entry(int data_type);
+
+//prints the GB/s of mda_convert_data for the conversions that have vectorized kernels, next to that of the scalar kernels
+void mda_convert_benchmark(bigint n);
+
 //here's an example usage function. See top of file for more info.
 void transpose_array(char* infile_path, char* outfile_path);
 
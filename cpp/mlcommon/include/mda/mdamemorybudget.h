@@ -0,0 +1,69 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MDAMEMORYBUDGET_H
+#define MDAMEMORYBUDGET_H
+
+#include <stdint.h>
+
+typedef int64_t bigint;
+
+/** \class MdaMemoryBudget - process-wide limit on the memory held by arrays
+ * @brief The MdaMemoryBudget class
+ *
+ * Mda, Mda32 and the chunk reads of DiskReadMda charge their buffers against this budget (subsystems "mda", "mda32" and "diskreadmda"). When a request would take the total above limit(), it either fails right away, so that for example Mda::allocate() returns false, or waits until other threads have released enough memory, depending on the policy of the calling thread. There is no limit by default.
+ *
+ * The live usage of each subsystem is reported through the <subsystem>_budget_bytes counter of the ICounterManager, if present. The counter is looked up on the first use of the subsystem in each thread, so it should be registered before arrays are allocated. Without a limit, charging and releasing cost an atomic add and no lock.
+ *
+ * \code
+ * MdaMemoryBudget::setLimit(4e9);
+ * MdaMemoryBudget::setThreadPolicy(MdaMemoryBudget::WaitWhenExceeded); // in each worker thread
+ * Mda X;
+ * if (!X.allocate(M, N)) {
+ *     // over budget
+ * }
+ * \endcode
+ */
+class MdaMemoryBudget {
+public:
+    enum Policy {
+        FailWhenExceeded,
+        WaitWhenExceeded
+    };
+
+    ///Set the maximum number of bytes that may be charged at any one time (0 means no limit)
+    static void setLimit(bigint num_bytes);
+    static bigint limit();
+    ///The number of bytes currently charged, over all subsystems
+    static bigint usedBytes();
+
+    ///Set the policy for threads that have not called setThreadPolicy() (default FailWhenExceeded)
+    static void setDefaultPolicy(Policy policy);
+    ///Set the policy of the calling thread
+    static void setThreadPolicy(Policy policy);
+    static Policy threadPolicy();
+    ///Set the maximum time in milliseconds that WaitWhenExceeded waits before failing (default -1, meaning wait indefinitely)
+    static void setWaitTimeout(int msec);
+
+    ///Charge num_bytes to the budget on behalf of subsystem. Returns false if the budget is exceeded (after waiting, under WaitWhenExceeded). A request larger than the whole limit fails immediately
+    static bool acquire(bigint num_bytes, const char* subsystem);
+    ///Give back num_bytes previously charged by acquire() on behalf of subsystem, waking up threads that are waiting
+    static void release(bigint num_bytes, const char* subsystem);
+    ///Charge num_bytes without checking the limit, for allocations that have no way to report failure (such as the copy made when a shared Mda is detached). Must be matched by release()
+    static void charge(bigint num_bytes, const char* subsystem);
+};
+
+#endif // MDAMEMORYBUDGET_H
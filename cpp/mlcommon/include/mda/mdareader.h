@@ -38,6 +38,22 @@ public:
     void setDevice(QIODevice*);
     void setFileName(const QString&);
 
+    ///Incremental reading of .mda data, for arrays that do not fit in memory or arrive over pipes and sockets.
+    ///Call readHeader() once, then readNext() until atEnd(). Entries come in storage order (first index fastest)
+    bool readHeader();
+    QVector<bigint> dims() const;
+    bigint totalSize() const;
+    ///Number of entries read so far
+    bigint position() const;
+    bool atEnd() const;
+    ///Read up to max_entries entries. Returns the number read (0 at the end), or -1 on error
+    bigint readNext(double* data, bigint max_entries);
+    bigint readNext(float* data, bigint max_entries);
+    ///Read the next num_timepoints columns (fewer at the end) of the array seen as N1 x M, allocating chunk as N1 x num_timepoints.
+    ///Returns false at the end or on error
+    bool readNext(Mda* chunk, bigint num_timepoints);
+    bool readNext(Mda32* chunk, bigint num_timepoints);
+
 private:
     MdaReaderPrivate* d;
 };
@@ -58,6 +74,18 @@ public:
     bool write(const Mda&);
     bool write(const Mda32&);
 
+    ///Incremental writing of .mda data: write the header for an array with the given dims,
+    ///append all of its entries in storage order with writeNext(), then call finish()
+    bool writeHeader(const QVector<bigint>& dims);
+    bool writeNext(const double* data, bigint num_entries);
+    bool writeNext(const float* data, bigint num_entries);
+    bool writeNext(const Mda& chunk);
+    bool writeNext(const Mda32& chunk);
+    ///Number of entries written so far
+    bigint position() const;
+    ///Returns false unless exactly all entries were written. Commits the file when writing to a file name
+    bool finish();
+
 private:
     MdaWriterPrivate* d;
 };
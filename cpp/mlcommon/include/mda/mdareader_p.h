@@ -18,6 +18,8 @@
 
 #include <QByteArray>
 #include <QtEndian>
+#include <type_traits>
+#include <vector>
 
 class QIODevice;
 class Mda;
@@ -77,10 +79,16 @@ public:
         int32_t num_dims;
         QVector<uint64_t> dims;
     };
+    ///Reads the header, padding dims to at least 6 entries
+    bool readHeader(Header* header);
+    ///Sets the data type of the header from the format ("mda.<type>", default float64)
+    bool headerFromFormat(Header* header) const;
+    ///Writes the header, with 64-bit dims when one of them needs it (num_dims is taken from dims)
+    bool writeHeader(const Header& header);
     template <typename T>
     bool readLE(T* ptr)
     {
-        if (device()->read((char*)ptr, sizeof(T)) != sizeof(T))
+        if (!readBlock((char*)ptr, sizeof(T)))
             return false;
         *ptr = qFromLittleEndian(*ptr);
         return true;
@@ -89,31 +97,100 @@ public:
     bool writeLE(T val)
     {
         val = qToLittleEndian(val);
-        return (device()->write((char*)&val, sizeof(T)) == sizeof(T));
+        return writeBlock((const char*)&val, sizeof(T));
     }
 
+    ///Read exactly num_bytes, waiting for more data on sequential devices. Returns false at the end of the data
+    bool readBlock(char* data, qint64 num_bytes);
+    bool writeBlock(const char* data, qint64 num_bytes);
+
+    //Entries are transferred in blocks of this many bytes, converted between the block and the array in a single
+    //loop, so there are no per-entry device calls. When no conversion is needed they are transferred in place
+    static const size_t blockBytes = 1024 * 1024;
+
     template <typename src, typename dst>
     bool readData(dst* ptr, size_t cnt = 1)
     {
-        src val;
-        for (size_t i = 0; i < cnt; ++i) {
-            if (!readLE(&val))
+        if (std::is_same<src, dst>::value && (Q_BYTE_ORDER == Q_LITTLE_ENDIAN))
+            return readBlock((char*)ptr, cnt * sizeof(src));
+        std::vector<src> block(qMin(cnt, blockBytes / sizeof(src)));
+        while (cnt > 0) {
+            size_t n = qMin(cnt, block.size());
+            if (!readBlock((char*)block.data(), n * sizeof(src)))
                 return false;
-            *(ptr++) = val;
+            const src* X = block.data();
+            for (size_t i = 0; i < n; i++)
+                ptr[i] = qFromLittleEndian(X[i]);
+            ptr += n;
+            cnt -= n;
         }
         return true;
     }
     template <typename dst, typename src>
     bool writeData(src* ptr, size_t cnt = 1)
     {
-        dst val;
-        for (size_t i = 0; i < cnt; ++i) {
-            val = *(ptr++);
-            if (!writeLE(val))
+        if (std::is_same<typename std::remove_const<src>::type, dst>::value && (Q_BYTE_ORDER == Q_LITTLE_ENDIAN))
+            return writeBlock((const char*)ptr, cnt * sizeof(dst));
+        std::vector<dst> block(qMin(cnt, blockBytes / sizeof(dst)));
+        while (cnt > 0) {
+            size_t n = qMin(cnt, block.size());
+            dst* Y = block.data();
+            for (size_t i = 0; i < n; i++)
+                Y[i] = qToLittleEndian((dst)ptr[i]);
+            if (!writeBlock((const char*)Y, n * sizeof(dst)))
                 return false;
+            ptr += n;
+            cnt -= n;
         }
         return true;
     }
+
+    ///Read cnt entries stored as data_type, converting them to T
+    template <typename T>
+    bool readEntries(int32_t data_type, T* ptr, size_t cnt)
+    {
+        switch (data_type) {
+        case Byte:
+            return readData<unsigned char>(ptr, cnt);
+        case Float32:
+            return readData<float>(ptr, cnt);
+        case Int16:
+            return readData<int16_t>(ptr, cnt);
+        case Int32:
+            return readData<int32_t>(ptr, cnt);
+        case UInt16:
+            return readData<uint16_t>(ptr, cnt);
+        case Float64:
+            return readData<double>(ptr, cnt);
+        case UInt32:
+            return readData<uint32_t>(ptr, cnt);
+        default:
+            return false;
+        }
+    }
+    ///Write cnt entries as data_type
+    template <typename T>
+    bool writeEntries(int32_t data_type, const T* ptr, size_t cnt)
+    {
+        switch (data_type) {
+        case Byte:
+            return writeData<unsigned char>(ptr, cnt);
+        case Float32:
+            return writeData<float>(ptr, cnt);
+        case Int16:
+            return writeData<int16_t>(ptr, cnt);
+        case Int32:
+            return writeData<int32_t>(ptr, cnt);
+        case UInt16:
+            return writeData<uint16_t>(ptr, cnt);
+        case Float64:
+            return writeData<double>(ptr, cnt);
+        case UInt32:
+            return writeData<uint32_t>(ptr, cnt);
+        default:
+            return false;
+        }
+    }
 };
 
 class MdaIOHandlerMDAFactory : public MdaIOHandlerFactory {
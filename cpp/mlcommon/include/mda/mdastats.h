@@ -0,0 +1,86 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MDASTATS_H
+#define MDASTATS_H
+
+#include "diskreadmda.h"
+#include <QJsonObject>
+#include <QVector>
+
+struct MdaStatsSummary {
+    bigint count = 0; //number of entries, not counting NaN
+    bigint num_nan = 0;
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    double stdev = 0; //normalized by count-1
+    QVector<double> quantiles; //approximate, at the probabilities given by MdaStatistics::quantileProbabilities()
+
+    QJsonObject toJsonObject(const QVector<double>& probabilities) const;
+};
+
+class MdaStatisticsPrivate;
+/**
+ * \class MdaStatistics
+ * @brief Summary statistics of a DiskReadMda in a single streaming pass, without loading the array into memory
+ *
+ * The array is treated as N1 x M (channels x timepoints). Chunks of timepoints are read and processed by several threads, and each thread keeps, for every channel, the count, mean and sum of squared deviations (merged exactly between chunks and threads), the extremes, and a t-digest from which quantiles are estimated. The memory used is therefore bounded by the chunk size and the number of threads times the number of channels, independently of M. Global statistics combine all channels. NaN entries are counted but otherwise ignored.
+ *
+ * \code
+ * MdaStatistics S;
+ * if (S.compute(DiskReadMda("raw.mda"))) {
+ *     MdaStatsSummary all = S.global();
+ *     MdaStatsSummary ch0 = S.channel(0);
+ * }
+ * \endcode
+ */
+class MdaStatistics {
+public:
+    friend class MdaStatisticsPrivate;
+    MdaStatistics();
+    virtual ~MdaStatistics();
+
+    ///Probabilities (between 0 and 1) at which quantiles are estimated (default 0.001, 0.01, 0.5, 0.99, 0.999)
+    void setQuantileProbabilities(const QVector<double>& probabilities);
+    QVector<double> quantileProbabilities() const;
+    ///Accuracy of the quantile estimates, as the t-digest compression parameter (default 100). Memory per channel and thread grows linearly with it
+    void setCompression(double compression);
+    ///Number of entries per chunk (default 4M, rounded to whole timepoints)
+    void setChunkSize(bigint num_entries);
+    ///Number of threads (default QThread::idealThreadCount())
+    void setNumThreads(int num_threads);
+
+    ///Run over the whole array. Returns false if a chunk could not be read
+    bool compute(const DiskReadMda& X);
+
+    MdaStatsSummary global() const;
+    bigint numChannels() const;
+    MdaStatsSummary channel(bigint m) const;
+
+    ///The global statistics, and the per-channel statistics as an array "channels" if include_channels is set
+    QJsonObject toJsonObject(bool include_channels) const;
+
+private:
+    MdaStatisticsPrivate* d;
+    MdaStatistics(const MdaStatistics&);
+    void operator=(const MdaStatistics&);
+};
+
+///Compares the statistics of a small array with known values, with a single thread and chunk, and with several of each. Returns false on a mismatch
+bool mdastats_unit_test();
+
+#endif // MDASTATS_H
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MDAVIEW_H
+#define MDAVIEW_H
+
+#include <stdint.h>
+#include <type_traits>
+#include "mdaio.h"
+
+///The MDAIO_TYPE_* code corresponding to the C++ type T, for example MdaDataType<int16_t>::value==MDAIO_TYPE_INT16
+template <typename T>
+struct MdaDataType;
+template <>
+struct MdaDataType<unsigned char> {
+    enum { value = MDAIO_TYPE_BYTE };
+};
+template <>
+struct MdaDataType<float> {
+    enum { value = MDAIO_TYPE_FLOAT32 };
+};
+template <>
+struct MdaDataType<int16_t> {
+    enum { value = MDAIO_TYPE_INT16 };
+};
+template <>
+struct MdaDataType<int32_t> {
+    enum { value = MDAIO_TYPE_INT32 };
+};
+template <>
+struct MdaDataType<uint16_t> {
+    enum { value = MDAIO_TYPE_UINT16 };
+};
+template <>
+struct MdaDataType<double> {
+    enum { value = MDAIO_TYPE_FLOAT64 };
+};
+template <>
+struct MdaDataType<uint32_t> {
+    enum { value = MDAIO_TYPE_UINT32 };
+};
+
+/** \class MdaView - a non-owning multi-dimensional view onto a buffer of entries of type T
+ * @brief The MdaView class
+ *
+ * An MdaView does not allocate or free memory. It simply aliases a buffer owned by someone else (for example a caller-provided array or a memory-mapped .mda file), so it must not outlive that buffer. Use MdaView<const T> for read-only access. All indexing is 0-based, as in Mda.
+ */
+template <typename T>
+class MdaView {
+public:
+    typedef typename std::remove_const<T>::type value_type;
+
+    ///Construct a null view
+    MdaView()
+    {
+        m_data = 0;
+        for (int i = 0; i < 6; i++)
+            m_dims[i] = 0;
+    }
+    ///Construct a view of size N1xN2x...xN6 onto the buffer data
+    MdaView(T* data, bigint N1, bigint N2 = 1, bigint N3 = 1, bigint N4 = 1, bigint N5 = 1, bigint N6 = 1)
+    {
+        m_data = data;
+        m_dims[0] = N1;
+        m_dims[1] = N2;
+        m_dims[2] = N3;
+        m_dims[3] = N4;
+        m_dims[4] = N5;
+        m_dims[5] = N6;
+    }
+    ///A read-only view can always be constructed from a writable one
+    template <typename S>
+    MdaView(const MdaView<S>& other)
+    {
+        m_data = other.data();
+        for (int i = 0; i < 6; i++)
+            m_dims[i] = other.N(i + 1);
+    }
+
+    ///The MDAIO_TYPE_* code of the entries
+    static int dataType() { return MdaDataType<value_type>::value; }
+
+    ///True if the view does not point to any data
+    bool isNull() const { return m_data == 0; }
+    ///The number of dimensions. This will be between 2 and 6, as in Mda
+    int ndims() const
+    {
+        for (int i = 5; i >= 2; i--) {
+            if (m_dims[i] > 1)
+                return i + 1;
+        }
+        return 2;
+    }
+    bigint N1() const { return m_dims[0]; }
+    bigint N2() const { return m_dims[1]; }
+    bigint N3() const { return m_dims[2]; }
+    bigint N4() const { return m_dims[3]; }
+    bigint N5() const { return m_dims[4]; }
+    bigint N6() const { return m_dims[5]; }
+    ///The size of the view along the dimension dim (1-based indexing)
+    bigint N(int dim) const
+    {
+        if ((dim < 1) || (dim > 6))
+            return 1;
+        return m_dims[dim - 1];
+    }
+    ///The product of N1..N6
+    bigint totalSize() const { return m_dims[0] * m_dims[1] * m_dims[2] * m_dims[3] * m_dims[4] * m_dims[5]; }
+
+    ///Raw pointer to the aliased buffer
+    T* data() const { return m_data; }
+    ///Raw pointer to the entry at location i of the vectorized view
+    T* dataPtr(bigint i) const { return m_data + i; }
+
+    ///The entry at location i of the vectorized view. No bounds checking is performed
+    T& operator[](bigint i) const { return m_data[i]; }
+    ///The entry at location i of the vectorized view. No bounds checking is performed
+    value_type value(bigint i) const { return m_data[i]; }
+    ///The entry at location (i1,i2). No bounds checking is performed
+    value_type value(bigint i1, bigint i2) const { return m_data[i1 + m_dims[0] * i2]; }
+    ///The entry at location (i1,i2,i3). No bounds checking is performed
+    value_type value(bigint i1, bigint i2, bigint i3) const { return m_data[i1 + m_dims[0] * i2 + m_dims[0] * m_dims[1] * i3]; }
+
+    ///A view of the sub-range of size N of the vectorized data starting at position i
+    MdaView subView(bigint i, bigint N) const { return MdaView(m_data + i, N, 1); }
+
+private:
+    T* m_data;
+    bigint m_dims[6];
+};
+
+#endif // MDAVIEW_H
@@ -25,6 +25,8 @@ FILE* jfopen(const char* path, const char* mode);
 void jfclose(FILE* F);
 bigint jfread(void* data, size_t sz, bigint num, FILE* F);
 bigint jfwrite(void* data, size_t sz, bigint num, FILE* F);
+bigint jpread(void* data, size_t sz, bigint num, int fd, bigint offset); //positional read that does not touch the file offset, so it is safe to share fd between threads
+bigint jpwrite(const void* data, size_t sz, bigint num, int fd, bigint offset); //positional write, likewise
 bigint jnumfilesopen();
 
 void* jmalloc(size_t num_bytes);
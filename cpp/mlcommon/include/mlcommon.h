@@ -52,9 +52,11 @@ QString mlLogPath();
 QString resolvePath(const QString& basepath, const QString& path);
 void mkdirIfNeeded(const QString& path);
 QString computeSha1SumOfFile(const QString& path);
+QStringList computeSha1SumOfFiles(const QStringList& paths); //same as computeSha1SumOfFile for each path, with a single checksum index lookup
 QString computeSha1SumOfFileHead(const QString& path, bigint num_bytes);
 QString computeSha1SumOfString(const QString& str);
 QString computeSha1SumOfDirectory(const QString& path);
+void benchmarkSha1SumOfFile(const QString& path, int num_passes = 3); //prints the GB/s of the sha1 and of the tree hash (see sumit.h) of a file, without using the checksum index
 bool matchesFastChecksum(QString path, QString fcs);
 QList<int> stringListToIntList(const QStringList& list);
 QList<bigint> stringListToBigIntList(const QStringList& list);
@@ -78,6 +80,8 @@ QStringList configResolvedPathList(const QString& group, const QString& key);
 QStringList toStringList(const QVariant& val); //val is either a string or a QVariantList
 QJsonObject createPrvObject(const QString& file_or_dir_path);
 QString locatePrv(const QJsonObject& obj, const QStringList& local_search_paths);
+//locatePrv for several objects (empty strings for those not found), searching for all the files in a single pass
+QStringList locatePrvBatch(const QList<QJsonObject>& objects, const QStringList& local_search_paths);
 };
 
 namespace MLCompute {
@@ -115,6 +119,21 @@ double min(const MLVector<double>& X);
 double max(const MLVector<double>& X);
 int min(const MLVector<int>& X);
 int max(const MLVector<int>& X);
+
+double stdev(bigint N, const double* X);
+double correlation(bigint N, const double* X1, const double* X2);
+///Minimum and maximum in a single pass (both 0 if N is 0)
+void minMax(bigint N, const double* X, double& min, double& max);
+void minMax(bigint N, const float* X, double& min, double& max);
+///Mean and standard deviation (normalized by N-1) in a single pass
+void meanStdev(bigint N, const double* X, double& mean, double& stdev);
+void meanStdev(bigint N, const float* X, double& mean, double& stdev);
+
+///Arrays with at least this many entries are reduced by several threads (default 4M entries, 0 disables)
+void setParallelThreshold(bigint num_entries);
+bigint parallelThreshold();
+///Prints the GB/s of the reductions on arrays of num_entries doubles and floats, on a single thread and on several
+void benchmark(bigint num_entries);
 }
 
 class CLParams {
@@ -133,6 +152,7 @@ T MLCompute::max(const QVector<T>& X)
 }
 
 QString locate_prv(const QJsonObject& obj);
+QStringList locate_prv_batch(const QList<QJsonObject>& objects);
 
 /*
 QString resolve_prv_object(const QJsonObject& obj, bool allow_downloads, bool allow_processing);
@@ -0,0 +1,31 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MLTHREADS_H
+#define MLTHREADS_H
+
+#include <QList>
+#include <functional>
+
+/**
+ * Run the tasks in parallel and return once all of them are done. The first task runs in the calling thread.
+ *
+ * By default the other tasks are queued on QThreadPool::globalInstance(), whose threads are created once and reused, so short parallel sections do not pay for starting threads. A task that no pool thread has picked up by the time the calling thread is free is run by the calling thread itself. The tasks must therefore not wait for one another, but run_in_threads() may be called from within a task.
+ *
+ * With dedicated_threads, every other task gets a thread of its own instead, for tasks that do wait for one another (such as a reader feeding a consumer).
+ */
+void run_in_threads(const QList<std::function<void()> >& tasks, bool dedicated_threads = false);
+
+#endif // MLTHREADS_H
@@ -17,33 +17,138 @@
 #define MLVECTOR_H
 
 #include <vector>
+#include <algorithm>
+#include <new>
+#include <stdlib.h>
 #include <QString>
+#include "mdabufferpool.h"
 
+/** \class MLPoolAllocator - allocator drawing from MdaBufferPool
+ * @brief Storage is aligned to MDA_BUFFER_ALIGNMENT (64) bytes and recycled through the same per-thread cache as Mda, so vectors that are rebuilt for every chunk stop going to malloc
+ */
 template <typename T>
-class MLVector : public std::vector<T> {
+class MLPoolAllocator {
+public:
+    typedef T value_type;
+    MLPoolAllocator() {}
+    template <typename U>
+    MLPoolAllocator(const MLPoolAllocator<U>&) {}
+    T* allocate(std::size_t n)
+    {
+        T* ret = (T*)MdaBufferPool::allocate(n * sizeof(T));
+        if ((!ret) && (n))
+            throw std::bad_alloc();
+        return ret;
+    }
+    void deallocate(T* p, std::size_t n)
+    {
+        MdaBufferPool::release(p, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const MLPoolAllocator<T>&, const MLPoolAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const MLPoolAllocator<T>&, const MLPoolAllocator<U>&) { return false; }
+
+/** \class MLAlignedAllocator - allocator returning memory aligned to Alignment bytes, straight from the system
+ */
+template <typename T, std::size_t Alignment = 64>
+class MLAlignedAllocator {
+public:
+    typedef T value_type;
+    template <typename U>
+    struct rebind {
+        typedef MLAlignedAllocator<U, Alignment> other;
+    };
+    MLAlignedAllocator() {}
+    template <typename U>
+    MLAlignedAllocator(const MLAlignedAllocator<U, Alignment>&) {}
+    T* allocate(std::size_t n)
+    {
+        if (!n)
+            return 0;
+        void* ret = 0;
+#ifdef __WIN32
+        ret = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+        if (posix_memalign(&ret, Alignment, n * sizeof(T)) != 0)
+            ret = 0;
+#endif
+        if (!ret)
+            throw std::bad_alloc();
+        return (T*)ret;
+    }
+    void deallocate(T* p, std::size_t)
+    {
+#ifdef __WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+};
+
+template <typename T, typename U, std::size_t A>
+bool operator==(const MLAlignedAllocator<T, A>&, const MLAlignedAllocator<U, A>&) { return true; }
+template <typename T, typename U, std::size_t A>
+bool operator!=(const MLAlignedAllocator<T, A>&, const MLAlignedAllocator<U, A>&) { return false; }
+
+/** \class MLVector - a std::vector with a QVector-like interface, 64-bit sizes and aligned storage
+ * @brief By default the storage comes from MLPoolAllocator (64-byte aligned, shared with the Mda buffer pool); another allocator, such as MLAlignedAllocator or std::allocator, can be given as the second template argument
+ *
+ * When the final size is not known in advance, use reserveAdditional() or append(data, n) rather than calling reserve(size() + n) in a loop, which would reallocate for every batch.
+ */
+template <typename T, typename Allocator = MLPoolAllocator<T> >
+class MLVector : public std::vector<T, Allocator> {
 public:
-    using std::vector<T>::vector;
+    typedef std::vector<T, Allocator> Base;
+    using Base::Base;
+    MLVector() {}
+
     MLVector& operator<<(const T& val)
     {
         this->emplace_back(val);
         return *this;
     }
-    qintptr count() const { return (qintptr)std::vector<T>::size(); } // breaks for large values
-    T operator[](qintptr i) const { return std::vector<T>::operator[]((std::size_t)i); }
-    T& operator[](qintptr i) { return std::vector<T>::operator[]((std::size_t)i); }
-    bool isEmpty() const { return std::vector<T>::size() == 0; }
-    void append(const MLVector<T>& other) { this->insert(this->end(), other.begin(), other.end()); }
-    /// Witold, when you have a chance, I need the proper way to set constBegin=begin and constEnd=end for consistency with QVector. The following did not compile:
-    //std::vector<T>::const_iterator constBegin() const {return begin();}
-    //std::vector<T>::const_iterator constEnd() const {return end();}
-    T value(qintptr i) const
-    {
-        if (i < 0)
-            return 0;
-        if (i >= this->count())
-            return 0;
+    bigint count() const { return (bigint)Base::size(); }
+    const T& operator[](bigint i) const { return Base::operator[]((std::size_t)i); }
+    T& operator[](bigint i) { return Base::operator[]((std::size_t)i); }
+    bool isEmpty() const { return Base::empty(); }
+    typename Base::const_iterator constBegin() const { return Base::cbegin(); }
+    typename Base::const_iterator constEnd() const { return Base::cend(); }
+    T value(bigint i) const
+    {
+        if ((i < 0) || (i >= this->count()))
+            return T();
         return (*this)[i];
     }
+
+    ///Make room for n more entries, growing the capacity geometrically so that repeated calls take amortized constant time per entry
+    void reserveAdditional(bigint n)
+    {
+        std::size_t needed = Base::size() + (std::size_t)n;
+        if (needed > Base::capacity())
+            Base::reserve(std::max(needed, 2 * Base::capacity()));
+    }
+    void append(const T* data, bigint n)
+    {
+        reserveAdditional(n);
+        this->insert(this->end(), data, data + n);
+    }
+    template <typename OtherAllocator>
+    void append(const std::vector<T, OtherAllocator>& other)
+    {
+        append(other.data(), (bigint)other.size());
+    }
+    ///Add n value-initialized entries and return a pointer to the first of them, to be filled in place
+    T* extend(bigint n)
+    {
+        reserveAdditional(n);
+        std::size_t old_size = Base::size();
+        Base::resize(old_size + (std::size_t)n);
+        return Base::data() + old_size;
+    }
 };
 
 #endif // MLVECTOR_H
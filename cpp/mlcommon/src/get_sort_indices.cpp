@@ -14,59 +14,223 @@
  * limitations under the License.
  */
 #include "get_sort_indices.h"
+#include "mlthreads.h"
 
+#include <QElapsedTimer>
+#include <QThread>
 #include <QVector>
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+/*
+ * The keys are copied next to their indices and sorted as (key, index) pairs,
+ * so that no comparison has to look up the key through the index. The keys
+ * are first mapped to unsigned integers with the same ordering, which are
+ * sorted with a stable LSD radix sort (one byte per pass, skipping bytes that
+ * are the same for all keys). Large inputs are split into parts that are
+ * radix sorted on separate threads and then merged.
+ *
+ * As with the std::stable_sort these functions replace, equal keys keep their
+ * original order. NaN values end up at the start (negative sign bit) or the
+ * end of the order.
+ */
+
+#define SMALL_SORT_SIZE 64
+#define PARALLEL_SORT_SIZE (4 * 1024 * 1024)
+#define MIN_SORT_PART_SIZE (1024 * 1024)
+
+namespace {
+
+inline uint32_t sort_key(int x)
+{
+    return (uint32_t)x ^ 0x80000000u;
+}
+
+inline uint64_t sort_key(double x)
+{
+    if (x == 0)
+        x = 0; //-0 and +0 compare equal
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    //negative numbers: flip all bits so that larger magnitudes come first; positive numbers: set the sign bit so that they come after
+    return (bits & 0x8000000000000000ull) ? ~bits : (bits | 0x8000000000000000ull);
+}
+
+template <typename K, typename I>
+struct KeyIndex {
+    K key;
+    I index;
+    bool operator<(const KeyIndex& other) const { return key < other.key; }
+};
+
+//stable sort of data[0..n-1] by key, using tmp as scratch space of the same size
+template <typename K, typename I>
+void radix_sort(KeyIndex<K, I>* data, KeyIndex<K, I>* tmp, bigint n)
+{
+    if (n < SMALL_SORT_SIZE) {
+        std::stable_sort(data, data + n);
+        return;
+    }
+    const int num_passes = sizeof(K);
+    //the histograms of all passes are made in a single read of the data
+    std::vector<bigint> counts(num_passes * 256, 0);
+    for (bigint i = 0; i < n; i++) {
+        K key = data[i].key;
+        for (int p = 0; p < num_passes; p++)
+            counts[p * 256 + ((key >> (8 * p)) & 0xff)]++;
+    }
+    KeyIndex<K, I>* src = data;
+    KeyIndex<K, I>* dst = tmp;
+    for (int p = 0; p < num_passes; p++) {
+        bigint* offsets = counts.data() + p * 256;
+        int shift = 8 * p;
+        if (offsets[(src[0].key >> shift) & 0xff] == n)
+            continue; //all keys have the same byte here
+        bigint offset = 0;
+        for (int b = 0; b < 256; b++) {
+            bigint count = offsets[b];
+            offsets[b] = offset;
+            offset += count;
+        }
+        for (bigint i = 0; i < n; i++)
+            dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+        std::swap(src, dst);
+    }
+    if (src != data)
+        std::copy(src, src + n, data);
+}
+
+//radix sort num_parts parts in parallel, then merge neighboring runs (also in parallel) until one is left
+template <typename K, typename I>
+void parallel_sort(KeyIndex<K, I>* data, KeyIndex<K, I>* tmp, bigint n, int num_parts)
+{
+    QVector<bigint> bounds(num_parts + 1);
+    for (int p = 0; p <= num_parts; p++)
+        bounds[p] = n * p / num_parts;
+    {
+        QList<std::function<void()> > tasks;
+        for (int p = 0; p < num_parts; p++) {
+            bigint i1 = bounds[p], i2 = bounds[p + 1];
+            tasks << [=]() { radix_sort(data + i1, tmp + i1, i2 - i1); };
+        }
+        run_in_threads(tasks);
+    }
+    KeyIndex<K, I>* src = data;
+    KeyIndex<K, I>* dst = tmp;
+    for (int width = 1; width < num_parts; width *= 2) {
+        QList<std::function<void()> > tasks;
+        for (int p = 0; p < num_parts; p += 2 * width) {
+            bigint i1 = bounds[p];
+            bigint i2 = bounds[qMin(p + width, num_parts)];
+            bigint i3 = bounds[qMin(p + 2 * width, num_parts)];
+            //std::merge takes equal elements from the first range first, which keeps the sort stable
+            tasks << [=]() { std::merge(src + i1, src + i2, src + i2, src + i3, dst + i1); };
+        }
+        run_in_threads(tasks);
+        std::swap(src, dst);
+    }
+    if (src != data)
+        std::copy(src, src + n, data);
+}
+
+//the permutation that stably sorts X[0..n-1], written to indices
+template <typename T, typename I>
+void sort_indices(const T* X, bigint n, I* indices)
+{
+    typedef decltype(sort_key(T())) K;
+    std::vector<KeyIndex<K, I> > data(n), tmp(n);
+    for (bigint i = 0; i < n; i++) {
+        data[i].key = sort_key(X[i]);
+        data[i].index = (I)i;
+    }
+    int num_parts = 1;
+    if (n >= PARALLEL_SORT_SIZE)
+        num_parts = (int)qMin((bigint)QThread::idealThreadCount(), n / MIN_SORT_PART_SIZE);
+    if (num_parts > 1)
+        parallel_sort(data.data(), tmp.data(), n, num_parts);
+    else
+        radix_sort(data.data(), tmp.data(), n);
+    for (bigint i = 0; i < n; i++)
+        indices[i] = data[i].index;
+}
+}
 
 QList<int> get_sort_indices(const QList<int>& X)
 {
-    QList<int> result;
-    result.reserve(X.size());
-    for (int i = 0; i < X.size(); ++i)
-        result << i;
-    std::stable_sort(result.begin(), result.end(),
-        [&X](int i1, int i2) { return X[i1] < X[i2]; });
-    return result;
+    QVector<int> keys = X.toVector();
+    QVector<int> indices(keys.count());
+    sort_indices(keys.constData(), keys.count(), indices.data());
+    return indices.toList();
 }
 
 QVector<int> get_sort_indices(const QVector<int>& X)
 {
     QVector<int> result(X.size());
-    for (int i = 0; i < X.size(); ++i)
-        result << i;
-    std::stable_sort(result.begin(), result.end(),
-        [&X](int i1, int i2) { return X[i1] < X[i2]; });
+    sort_indices(X.constData(), X.count(), result.data());
     return result;
 }
 
 QList<int> get_sort_indices(const QVector<double>& X)
 {
-    QList<int> result;
-    result.reserve(X.size());
-    for (int i = 0; i < X.size(); ++i)
-        result << i;
-    std::stable_sort(result.begin(), result.end(),
-        [&X](int i1, int i2) { return X[i1] < X[i2]; });
-    return result;
+    QVector<int> indices(X.count());
+    sort_indices(X.constData(), X.count(), indices.data());
+    return indices.toList();
 }
 
 QList<bigint> get_sort_indices_bigint(const QVector<double>& X)
 {
-    QList<bigint> result;
-    result.reserve(X.size());
-    for (bigint i = 0; i < X.size(); ++i)
-        result << i;
-    std::stable_sort(result.begin(), result.end(),
-        [&X](bigint i1, bigint i2) { return X[i1] < X[i2]; });
-    return result;
+    QVector<bigint> indices(X.count());
+    sort_indices(X.constData(), X.count(), indices.data());
+    return indices.toList();
 }
 
 MLVector<bigint> get_sort_indices(const MLVector<double>& X)
 {
     MLVector<bigint> result;
-    result.reserve(X.size());
-    for (bigint i = 0; i < X.count(); ++i)
-        result << i;
-    std::stable_sort(result.begin(), result.end(),
-        [&X](bigint i1, bigint i2) { return X[i1] < X[i2]; });
+    result.resize(X.size());
+    sort_indices(X.data(), X.count(), result.data());
     return result;
 }
+
+void get_sort_indices_benchmark(bigint max_size)
+{
+    printf("get_sort_indices_benchmark...\n");
+    printf("%12s %14s %14s %10s\n", "size", "radix (ns/el)", "stable (ns/el)", "speedup");
+    for (bigint n = 1000; n <= max_size; n *= 10) {
+        MLVector<double> X(n);
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        for (bigint i = 0; i < n; i++) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            X[i] = (double)(state >> 11) / (double)(1ull << 53) - 0.5;
+        }
+        //small sizes are repeated so that every measurement takes a while
+        int num_repeats = (int)qMax((bigint)1, 10000000 / n);
+        QElapsedTimer timer;
+
+        timer.start();
+        MLVector<bigint> indices1;
+        for (int r = 0; r < num_repeats; r++)
+            indices1 = get_sort_indices(X);
+        double radix_ns = (double)timer.nsecsElapsed() / num_repeats / n;
+
+        timer.start();
+        MLVector<bigint> indices2;
+        for (int r = 0; r < num_repeats; r++) {
+            indices2.resize(n);
+            for (bigint i = 0; i < n; i++)
+                indices2[i] = i;
+            std::stable_sort(indices2.begin(), indices2.end(),
+                [&X](bigint i1, bigint i2) { return X[i1] < X[i2]; });
+        }
+        double stable_ns = (double)timer.nsecsElapsed() / num_repeats / n;
+
+        if (indices1 != indices2) {
+            printf("Mismatch between the two sorts at size %ld\n", (long)n);
+            return;
+        }
+        printf("%12ld %14.2f %14.2f %9.2fx\n", (long)n, radix_ns, stable_ns, stable_ns / radix_ns);
+    }
+}
@@ -24,12 +24,33 @@
 #include <QJsonDocument>
 #include "cachemanager.h"
 #include "mlcommon.h"
+#include "mdabufferpool.h"
+#include "mdamemorybudget.h"
+#include "mlthreads.h"
 #include <QJsonArray>
 #include <icounter.h>
 #include <objectregistry.h>
+#include <QMutex>
+#include <QHash>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define MAX_PATH_LEN 10000
-#define DEFAULT_CHUNK_SIZE 1e5
+//value() caches aligned blocks of this many entries, keeping the most recently used ones up to the cache size in bytes
+#define VALUE_CACHE_BLOCK_SIZE 16384
+#define DEFAULT_VALUE_CACHE_SIZE (8 * 1024 * 1024)
+//for hyper-rectangle reads through stdio, consecutive runs separated by at most this many bytes are fetched with a single read
+#define MAX_COALESCE_GAP_BYTES 65536
+#define MAX_COALESCE_SPAN_BYTES (64 * 1024 * 1024)
+//reads of a concatenated array that span several segments are issued in parallel once they are at least this large
+#define MIN_PARALLEL_CONCAT_READ_BYTES (4 * 1024 * 1024)
 
 /// TODO (LOW) make tmp directory with different name on server, so we can really test if it is doing the computation in the right place
 
@@ -38,29 +59,57 @@ public:
     DiskReadMda* q;
     FILE* m_file;
     bool m_file_open_failed;
+    bool m_use_mmap = false;
+    bool m_mmap_failed = false;
+    char* m_mapped_data = 0;
+    bigint m_mapped_size = 0;
     bool m_header_read;
     MDAIO_HEADER m_header;
     bool m_reshaped;
     bigint m_mda_header_total_size;
-    Mda m_internal_chunk;
-    int m_current_internal_chunk_index;
+    struct CacheBlock {
+        bigint index;
+        Mda data;
+    };
+    std::list<CacheBlock> m_value_cache; //most recently used first
+    QHash<bigint, std::list<CacheBlock>::iterator> m_value_cache_index;
+    bigint m_value_cache_size = DEFAULT_VALUE_CACHE_SIZE;
+    int m_value_cache_hits = 0; //not yet added to cacheHitsCounter
     Mda m_memory_mda;
     bool m_use_memory_mda = false;
     bool m_use_concat = false;
     int m_concat_dimension = 2;
     QList<DiskReadMda> m_concat_list;
+    //along the concat dimension k, the array consists of outer slices (one per index of dimensions k+1..6), each holding a contiguous block of every segment in turn. m_concat_offsets holds the position of each segment's block within a slice, with the slice size appended. Computed with the header
+    QVector<bigint> m_concat_offsets;
 
     QString m_path;
     QJsonObject m_prv_object;
 
+    //guards the lazy opening of the file, reading of the header and mapping. Once the file is open, reads use pread and need no lock
+    QMutex m_init_mutex { QMutex::Recursive };
+    //guards the value() cache. It is not held while a missing block is read
+    QMutex m_value_mutex;
+
     IIntCounter* allocatedCounter = nullptr;
     IIntCounter* freedCounter = nullptr;
     IIntCounter* bytesReadCounter = nullptr;
     IIntCounter* bytesWrittenCounter = nullptr;
+    IIntCounter* cacheHitsCounter = nullptr;
+    IIntCounter* cacheMissesCounter = nullptr;
+    IIntCounter* cacheEvictionsCounter = nullptr;
 
     void construct_and_clear();
     bool read_header_if_needed();
     bool open_file_if_needed();
+    bool map_file_if_needed();
+    void close_file();
+    bigint read_entries(void* data, int data_type, bigint i, bigint n);
+    bool read_concat_entries(void* data, int data_type, bigint i, bigint n);
+    const Mda* find_value_cache_block(bigint block_index);
+    const Mda* insert_value_cache_block(bigint block_index, const Mda& data);
+    void clear_value_cache();
+    void flush_cache_hits();
     void copy_from(const DiskReadMda& other);
     bigint total_size();
     static QStringList find_all_mda_files_in_directory(QString dir_path, bool recursive);
@@ -76,6 +125,9 @@ DiskReadMda::DiskReadMda(const QString& path)
         d->freedCounter = static_cast<IIntCounter*>(manager->counter("freed_bytes"));
         d->bytesReadCounter = static_cast<IIntCounter*>(manager->counter("bytes_read"));
         d->bytesWrittenCounter = static_cast<IIntCounter*>(manager->counter("bytes_written"));
+        d->cacheHitsCounter = static_cast<IIntCounter*>(manager->counter("diskreadmda_cache_hits"));
+        d->cacheMissesCounter = static_cast<IIntCounter*>(manager->counter("diskreadmda_cache_misses"));
+        d->cacheEvictionsCounter = static_cast<IIntCounter*>(manager->counter("diskreadmda_cache_evictions"));
     }
     d->construct_and_clear();
     if (!path.isEmpty()) {
@@ -114,7 +166,7 @@ DiskReadMda::DiskReadMda(const QJsonObject& prv_object)
     //QString path0 = resolve_prv_object(prv_object, allow_downloads, allow_processing);
     if (prv_object.value("use_concat").toBool()) {
         QJsonArray concat_list = prv_object["concat_list"].toArray();
-        int concat_dimension = prv_object["concat_dimension"].toInt();
+        int concat_dimension = prv_object["concat_dimension"].toInt(2);
         QStringList paths;
         for (int i = 0; i < concat_list.count(); i++) {
             QJsonObject prv_object0 = concat_list[i].toObject();
@@ -143,8 +195,8 @@ DiskReadMda::DiskReadMda(int concat_dimension, const QList<DiskReadMda>& arrays)
     d->q = this;
     d->construct_and_clear();
 
-    if (concat_dimension != 2) {
-        qCritical() << "For now concat_dimension must be 2!";
+    if ((concat_dimension < 1) || (concat_dimension > 6)) {
+        qCritical() << "concat_dimension must be between 1 and 6" << concat_dimension;
         return;
     }
 
@@ -168,8 +220,8 @@ DiskReadMda::DiskReadMda(int concat_dimension, const QStringList& array_paths)
         arrays << DiskReadMda(path);
     }
 
-    if (concat_dimension != 2) {
-        qCritical() << "For now concat_dimension must be 2!";
+    if ((concat_dimension < 1) || (concat_dimension > 6)) {
+        qCritical() << "concat_dimension must be between 1 and 6" << concat_dimension;
         return;
     }
 
@@ -180,9 +232,8 @@ DiskReadMda::DiskReadMda(int concat_dimension, const QStringList& array_paths)
 
 DiskReadMda::~DiskReadMda()
 {
-    if (d->m_file) {
-        fclose(d->m_file);
-    }
+    d->flush_cache_hits();
+    d->close_file();
     delete d;
 }
 
@@ -193,10 +244,7 @@ void DiskReadMda::operator=(const DiskReadMda& other)
 
 void DiskReadMda::setPath(const QString& file_path)
 {
-    if (d->m_file) {
-        fclose(d->m_file);
-        d->m_file = 0;
-    }
+    d->close_file();
     d->construct_and_clear();
 
     if ((file_path.endsWith(".txt")) || (file_path.endsWith(".csv"))) {
@@ -250,10 +298,45 @@ void DiskReadMda::setPrvObject(const QJsonObject& prv_object)
     d->m_prv_object = prv_object;
 }
 
+void DiskReadMda::setUseMmap(bool val)
+{
+    if (d->m_use_mmap == val)
+        return;
+    d->m_use_mmap = val;
+    if ((!val) && (d->m_mapped_data)) {
+        munmap(d->m_mapped_data, d->m_mapped_size);
+        d->m_mapped_data = 0;
+        d->m_mapped_size = 0;
+    }
+}
+
+bool DiskReadMda::useMmap() const
+{
+    return d->m_use_mmap;
+}
+
+void DiskReadMda::setValueCacheSize(bigint num_bytes)
+{
+    QMutexLocker locker(&d->m_value_mutex);
+    d->m_value_cache_size = num_bytes;
+    //evict down to the new size, but always keep at least one block
+    while ((d->m_value_cache.size() > 1) && ((bigint)d->m_value_cache.size() * VALUE_CACHE_BLOCK_SIZE * (bigint)sizeof(double) > num_bytes)) {
+        d->m_value_cache_index.remove(d->m_value_cache.back().index);
+        d->m_value_cache.pop_back();
+        if (d->cacheEvictionsCounter)
+            d->cacheEvictionsCounter->add(1);
+    }
+}
+
+bigint DiskReadMda::valueCacheSize() const
+{
+    return d->m_value_cache_size;
+}
+
 void DiskReadMda::setConcatPaths(int concat_dimension, const QStringList& paths)
 {
-    if (concat_dimension != 2) {
-        qWarning() << "For now, the concat_dimension must be 2";
+    if ((concat_dimension < 1) || (concat_dimension > 6)) {
+        qWarning() << "concat_dimension must be between 1 and 6" << concat_dimension;
         return;
     }
     d->m_use_concat = true;
@@ -492,192 +575,305 @@ DiskReadMda DiskReadMda::reshaped(bigint N1b, bigint N2b, bigint N3b, bigint N4b
     return ret;
 }
 
-bool read_chunk_from_concat_list(Mda& chunk, const QList<DiskReadMda>& list, bigint i0, bigint size0, int concat_dimension)
+bool DiskReadMda::readChunk(Mda& X, bigint i, bigint size) const
 {
-    if (list.count() == 0) {
-        qWarning() << "Problem in read_chunk_from concat_list: list is empty";
+    if (d->m_use_memory_mda) {
+        if (!X.allocateUninitialized(1, size))
+            return false;
+        d->m_memory_mda.getChunk(X.view(), i);
+        return true;
+    }
+    //every entry is written by readRawChunk (entries outside the array are set to zero), so there is no need to initialize
+    bool ok;
+    if (d->m_use_concat)
+        ok = X.allocateUninitialized(1, size);
+    else
+        ok = X.allocateUninitialized(size, 1);
+    if (!ok)
         return false;
+    return readRawChunk(X.dataPtr(), MDAIO_TYPE_FLOAT64, i, size);
+}
+
+bool DiskReadMda::readChunk(Mda& X, bigint i1, bigint i2, bigint size1, bigint size2) const
+{
+    if (size2 == 0) {
+        return readChunk(X, i1, size1);
     }
-    bigint N1 = list[0].N1();
-    if ((concat_dimension != 2) || (i0 % N1 != 0) || (size0 % N1 != 0)) {
-        qWarning() << "For now the concat_dimension must be 2 and the i and size in readChunk must be a multiples of N1";
+    if (!X.allocateUninitialized(size1, size2))
         return false;
+    if (d->m_use_memory_mda) {
+        d->m_memory_mda.getChunk(X.view(), i1, i2);
+        return true;
     }
-    bigint pos1 = i0 / N1;
-    bigint pos2 = pos1 + size0 / N1 - 1;
+    bigint start[2] = { i1, i2 };
+    bigint size[2] = { size1, size2 };
+    return readRawChunk(X.dataPtr(), MDAIO_TYPE_FLOAT64, 2, start, size);
+}
 
-    QVector<bigint> sizes;
-    for (int j = 0; j < list.count(); j++) {
-        if (list[j].totalSize() % N1 != 0) {
-            qWarning() << "For now the concat_dimension must be 2 and the individual arrays must have total size a multiple of N1." << N1 << list[j].totalSize();
-            return false;
+bool DiskReadMda::readChunk(Mda& X, bigint i1, bigint i2, bigint i3, bigint size1, bigint size2, bigint size3) const
+{
+    if (size3 == 0) {
+        if (size2 == 0) {
+            return readChunk(X, i1, size1);
+        }
+        else {
+            return readChunk(X, i1, i2, size1, size2);
         }
-        sizes << list[j].totalSize() / N1;
     }
-    QVector<bigint> start_points, end_points;
-    start_points << 0;
-    end_points << sizes.value(0) - 1;
-    for (int i = 1; i < sizes.count(); i++) {
-        start_points << end_points[i - 1] + 1;
-        end_points << start_points[i] + sizes[i] - 1;
+    if (!X.allocateUninitialized(size1, size2, size3))
+        return false;
+    if (d->m_use_memory_mda) {
+        d->m_memory_mda.getChunk(X.view(), i1, i2, i3);
+        return true;
     }
+    bigint start[3] = { i1, i2, i3 };
+    bigint size[3] = { size1, size2, size3 };
+    return readRawChunk(X.dataPtr(), MDAIO_TYPE_FLOAT64, 3, start, size);
+}
 
-    bigint ii1 = 0;
-    while ((ii1 + 1 < list.count()) && (pos1 > end_points[ii1])) {
-        ii1++;
-    }
-    bigint ii2 = ii1;
-    while ((ii2 + 1 < list.count()) && (start_points[ii2 + 1] <= pos2)) {
-        ii2++;
-    }
+bool DiskReadMda::readChunk(Mda32& X, bigint i, bigint size) const
+{
+    if (!X.allocateUninitialized(size, 1))
+        return false;
+    return readRawChunk(X.dataPtr(), MDAIO_TYPE_FLOAT32, i, size);
+}
 
-    chunk.allocate(1, N1 * (pos2 - pos1 + 1));
-    for (bigint ii = ii1; ii <= ii2; ii++) {
-        Mda chunk_ii;
+bool DiskReadMda::readChunk(Mda32& X, bigint i1, bigint i2, bigint size1, bigint size2) const
+{
+    if (size2 == 0) {
+        return readChunk(X, i1, size1);
+    }
+    if (!X.allocateUninitialized(size1, size2))
+        return false;
+    bigint start[2] = { i1, i2 };
+    bigint size[2] = { size1, size2 };
+    return readRawChunk(X.dataPtr(), MDAIO_TYPE_FLOAT32, 2, start, size);
+}
 
-        //ttA,ttB, the range to read from Y
-        //ssA, the position to write it in "out"
-        bigint ttA, ttB, ssA;
-        if (ii == ii1) {
-            bigint offset = pos1 - start_points[ii];
-            ssA = 0;
-            if (ii1 < ii2) {
-                ttA = offset;
-                ttB = sizes[ii] - 1;
-            }
-            else {
-                ttA = offset;
-                ttB = ttA + (pos2 - pos1 + 1) - 1;
-            }
-        }
-        else if (ii == ii2) {
-            ttA = 0;
-            ttB = pos2 - start_points[ii];
-            ssA = start_points[ii] - pos1;
+bool DiskReadMda::readChunk(Mda32& X, bigint i1, bigint i2, bigint i3, bigint size1, bigint size2, bigint size3) const
+{
+    if (size3 == 0) {
+        if (size2 == 0) {
+            return readChunk(X, i1, size1);
         }
         else {
-            ttA = 0;
-            ttB = sizes[ii] - 1;
-            ssA = start_points[ii] - pos1;
+            return readChunk(X, i1, i2, size1, size2);
         }
-
-        list[ii].readChunk(chunk_ii, N1 * ttA, N1 * (ttB - ttA + 1));
-        chunk.setChunk(chunk_ii, N1 * ssA);
     }
-    return true;
+    if (!X.allocateUninitialized(size1, size2, size3))
+        return false;
+    bigint start[3] = { i1, i2, i3 };
+    bigint size[3] = { size1, size2, size3 };
+    return readRawChunk(X.dataPtr(), MDAIO_TYPE_FLOAT32, 3, start, size);
 }
 
-bool DiskReadMda::readChunk(Mda& X, bigint i, bigint size) const
+bool DiskReadMda::readRawChunk(void* data, int data_type, bigint i, bigint size) const
 {
+    bigint num_bytes_per_entry = mda_get_num_bytes_per_entry(data_type);
+    if ((!num_bytes_per_entry) || (data_type == MDAIO_TYPE_COMPLEX)) {
+        qWarning() << "Unsupported data type in DiskReadMda::readRawChunk" << data_type;
+        return false;
+    }
+    if (size <= 0)
+        return true;
     if (d->m_use_memory_mda) {
-        d->m_memory_mda.getChunk(X, i, size);
+        if (data_type == MDAIO_TYPE_FLOAT64) {
+            d->m_memory_mda.getChunk(MdaView<double>((double*)data, size, 1), i);
+            return true;
+        }
+        //this is held as float64 anyway
+        Mda tmp;
+        if (!readChunk(tmp, i, size))
+            return false;
+        MDAIO_HEADER H;
+        H.data_type = MDAIO_TYPE_FLOAT64;
+        H.num_bytes_per_entry = sizeof(double);
+        mda_convert_data(data, data_type, &H, size, tmp.constDataPtr());
         return true;
     }
-    else if (d->m_use_concat) {
-        return read_chunk_from_concat_list(X, d->m_concat_list, i, size, d->m_concat_dimension);
-    }
     if (!d->open_file_if_needed())
         return false;
-    X.allocate(size, 1);
+    char* out = (char*)data;
     bigint jA = qMax(i, (bigint)0);
     bigint jB = qMin(i + size - 1, d->total_size() - 1);
+    if (jB < jA) {
+        memset(out, 0, size * num_bytes_per_entry);
+        return true;
+    }
+    if (jA > i)
+        memset(out, 0, (jA - i) * num_bytes_per_entry);
+    if (jB < i + size - 1)
+        memset(out + (jB + 1 - i) * num_bytes_per_entry, 0, (i + size - 1 - jB) * num_bytes_per_entry);
     bigint size_to_read = jB - jA + 1;
-    if (size_to_read > 0) {
-        fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (jA), SEEK_SET);
-        bigint bytes_read = mda_read_float64(&X.dataPtr()[jA - i], &d->m_header, size_to_read, d->m_file);
-        if (d->bytesReadCounter)
-            d->bytesReadCounter->add(bytes_read);
-        if (bytes_read != size_to_read) {
-            printf("Warning problem reading chunk in diskreadmda: %ld<>%ld\n", (bigint)bytes_read, (bigint)size_to_read);
-            return false;
-        }
+    if (d->m_use_concat) {
+        return d->read_concat_entries(out + (jA - i) * num_bytes_per_entry, data_type, jA, size_to_read);
+    }
+    bigint bytes_read = d->read_entries(out + (jA - i) * num_bytes_per_entry, data_type, jA, size_to_read);
+    if (d->bytesReadCounter)
+        d->bytesReadCounter->add(bytes_read);
+    if (bytes_read != size_to_read) {
+        printf("Warning problem reading raw chunk in diskreadmda: %ld<>%ld\n", (bigint)bytes_read, (bigint)size_to_read);
+        return false;
     }
     return true;
 }
 
-bool DiskReadMda::readChunk(Mda& X, bigint i1, bigint i2, bigint size1, bigint size2) const
+bool DiskReadMda::readRawChunk(void* data, int data_type, int ndims, const bigint* start, const bigint* size) const
 {
-    if (size2 == 0) {
-        return readChunk(X, i1, size1);
-    }
-    if (d->m_use_memory_mda) {
-        d->m_memory_mda.getChunk(X, i1, i2, size1, size2);
-        return true;
-    }
-    else if (d->m_use_concat) {
-        if (!readChunk(X, i1 + N1() * i2, size1 * size2))
-            return false;
-        return X.reshape(size1, size2);
+    bigint num_bytes_per_entry = mda_get_num_bytes_per_entry(data_type);
+    if ((!num_bytes_per_entry) || (data_type == MDAIO_TYPE_COMPLEX)) {
+        qWarning() << "Unsupported data type in DiskReadMda::readRawChunk" << data_type;
+        return false;
     }
-    if (!d->open_file_if_needed())
+    if ((ndims < 1) || (ndims > 6)) {
+        qWarning() << "Unsupported number of dimensions in DiskReadMda::readRawChunk" << ndims;
         return false;
-    if ((size1 == N1()) && (i1 == 0)) {
-        //easy case
-        X.allocate(size1, size2);
-        bigint jA = qMax(i2, (bigint)0);
-        bigint jB = qMin(i2 + size2 - 1, N2() - 1);
-        bigint size2_to_read = jB - jA + 1;
-        if (size2_to_read > 0) {
-            fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (i1 + N1() * jA), SEEK_SET);
-            bigint bytes_read = mda_read_float64(&X.dataPtr()[(jA - i2) * size1], &d->m_header, size1 * size2_to_read, d->m_file);
-            if (d->bytesReadCounter)
-                d->bytesReadCounter->add(bytes_read);
-            if (bytes_read != size1 * size2_to_read) {
-                printf("Warning problem reading 2d chunk in diskreadmda: %ld<>%ld\n", (bigint)bytes_read, (bigint)(size1 * size2));
-                return false;
-            }
-        }
-        return true;
     }
-    else {
-        printf("Warning: This case not yet supported (diskreadmda::readchunk 2d).\n");
+    if (!d->read_header_if_needed())
         return false;
+
+    //S=start, Z=size of the rectangle, N=dimensions of the array. The last requested dimension absorbs any remaining ones, so that ndims=1 corresponds to the vectorized array
+    bigint S[6], Z[6], N[6];
+    for (int dd = 0; dd < 6; dd++) {
+        S[dd] = (dd < ndims) ? start[dd] : 0;
+        Z[dd] = (dd < ndims) ? size[dd] : 1;
+        N[dd] = (dd < ndims) ? this->N(dd + 1) : 1;
+        if (Z[dd] <= 0)
+            return true;
+    }
+    for (int dd = ndims; dd < 6; dd++) {
+        N[ndims - 1] *= this->N(dd + 1);
     }
-}
 
-bool DiskReadMda::readChunk(Mda& X, bigint i1, bigint i2, bigint i3, bigint size1, bigint size2, bigint size3) const
-{
-    if (size3 == 0) {
-        if (size2 == 0) {
-            return readChunk(X, i1, size1);
-        }
-        else {
-            return readChunk(X, i1, i2, size1, size2);
-        }
+    //A..B-1 is the part of the rectangle that lies inside the array. Everything else is zero
+    bigint A[6], B[6];
+    bool clipped = false;
+    for (int dd = 0; dd < 6; dd++) {
+        A[dd] = qMax(S[dd], (bigint)0);
+        B[dd] = qMin(S[dd] + Z[dd], N[dd]);
+        if ((A[dd] != S[dd]) || (B[dd] != S[dd] + Z[dd]))
+            clipped = true;
     }
-    if (d->m_use_memory_mda) {
-        d->m_memory_mda.getChunk(X, i1, i2, i3, size1, size2, size3);
-        return true;
+    bigint total_size = Z[0] * Z[1] * Z[2] * Z[3] * Z[4] * Z[5];
+    if (clipped)
+        memset(data, 0, total_size * num_bytes_per_entry);
+    for (int dd = 0; dd < 6; dd++) {
+        if (A[dd] >= B[dd])
+            return true;
     }
-    else if (d->m_use_concat) {
-        if (!readChunk(X, i1 + N1() * i2 + N1() * N2() * i3, size1 * size2 * size3))
-            return false;
-        return X.reshape(size1, size2, size3);
+
+    //strides of the array (source) and of the output
+    bigint src_stride[6], out_stride[6];
+    src_stride[0] = out_stride[0] = 1;
+    for (int dd = 1; dd < 6; dd++) {
+        src_stride[dd] = src_stride[dd - 1] * N[dd - 1];
+        out_stride[dd] = out_stride[dd - 1] * Z[dd - 1];
     }
-    if (!d->open_file_if_needed())
+
+    //dimensions 0..k-1 are covered completely, so each run of entries along dimensions 0..k is contiguous in both the file and the output
+    int k = 0;
+    while ((k < 5) && (A[k] == 0) && (B[k] == N[k]) && (Z[k] == N[k]))
+        k++;
+    bigint run_len = src_stride[k] * (B[k] - A[k]);
+
+    //when reading through stdio, consecutive runs along dimension k+1 separated by a small gap are fetched with a single read and the gaps are discarded. The same is done for a concatenated array, where every read goes through the lookup of its segments
+    bool use_file = ((!d->m_use_memory_mda) && (!d->m_use_concat));
+    if ((use_file) && (!d->open_file_if_needed()))
         return false;
-    if ((size1 == N1()) && (size2 == N2())) {
-        //easy case
-        X.allocate(size1, size2, size3);
-        bigint jA = qMax(i3, (bigint)0);
-        bigint jB = qMin(i3 + size3 - 1, N3() - 1);
-        bigint size3_to_read = jB - jA + 1;
-        if (size3_to_read > 0) {
-            fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * (i1 + N1() * i2 + N1() * N2() * jA), SEEK_SET);
-            bigint bytes_read = mda_read_float64(&X.dataPtr()[(jA - i3) * size1 * size2], &d->m_header, size1 * size2 * size3_to_read, d->m_file);
-            if (d->bytesReadCounter)
-                d->bytesReadCounter->add(bytes_read);
-            if (bytes_read != size1 * size2 * size3_to_read) {
-                printf("Warning problem reading 3d chunk in diskreadmda: %ld<>%ld\n", (bigint)bytes_read, (bigint)(size1 * size2 * size3_to_read));
+    bigint span_bytes_per_entry = 0; //per entry of the span buffer, or 0 if runs are not combined
+    if ((use_file) && (!d->m_mapped_data))
+        span_bytes_per_entry = d->m_header.num_bytes_per_entry;
+    else if (d->m_use_concat)
+        span_bytes_per_entry = num_bytes_per_entry;
+    bigint batch_count = 1; //the maximum number of runs along dimension k+1 read as one span
+    if ((span_bytes_per_entry) && (k < 5) && (B[k + 1] - A[k + 1] > 1)) {
+        bigint gap_bytes = (src_stride[k + 1] - run_len) * span_bytes_per_entry;
+        if (gap_bytes <= MAX_COALESCE_GAP_BYTES) {
+            //as many runs as fit in a span of MAX_COALESCE_SPAN_BYTES
+            bigint max_span = MAX_COALESCE_SPAN_BYTES / span_bytes_per_entry;
+            if (max_span >= run_len)
+                batch_count = qMin(B[k + 1] - A[k + 1], (max_span - run_len) / src_stride[k + 1] + 1);
+        }
+    }
+    MdaPooledBuffer batch_buffer(0, "diskreadmda");
+
+    bigint j[6];
+    for (int dd = 0; dd < 6; dd++)
+        j[dd] = A[dd];
+    while (true) {
+        bigint src_index = 0, out_index = 0;
+        for (int dd = 0; dd < 6; dd++) {
+            src_index += j[dd] * src_stride[dd];
+            out_index += (j[dd] - S[dd]) * out_stride[dd];
+        }
+        char* out = (char*)data + out_index * num_bytes_per_entry;
+        bigint num_runs = (batch_count > 1) ? qMin(batch_count, B[k + 1] - j[k + 1]) : 1;
+        if (num_runs == 1) {
+            if (!use_file) {
+                if (!readRawChunk(out, data_type, src_index, run_len))
+                    return false;
+            }
+            else {
+                bigint num_read = d->read_entries(out, data_type, src_index, run_len);
+                if (d->bytesReadCounter)
+                    d->bytesReadCounter->add(num_read);
+                if (num_read != run_len) {
+                    printf("Warning problem reading chunk in diskreadmda: %ld<>%ld\n", (bigint)num_read, (bigint)run_len);
+                    return false;
+                }
+            }
+        }
+        else {
+            bigint span = (num_runs - 1) * src_stride[k + 1] + run_len;
+            if (!batch_buffer.resize(span * span_bytes_per_entry))
                 return false;
+            if (!use_file) {
+                //read in the requested type, so the runs are simply copied out
+                if (!readRawChunk(batch_buffer.data(), data_type, src_index, span))
+                    return false;
+                for (bigint r = 0; r < num_runs; r++) {
+                    memcpy(out + r * out_stride[k + 1] * num_bytes_per_entry, batch_buffer.data() + r * src_stride[k + 1] * num_bytes_per_entry, run_len * num_bytes_per_entry);
+                }
+            }
+            else {
+                bigint num_read = d->read_entries(batch_buffer.data(), d->m_header.data_type, src_index, span);
+                if (d->bytesReadCounter)
+                    d->bytesReadCounter->add(num_read);
+                if (num_read != span) {
+                    printf("Warning problem reading chunk in diskreadmda: %ld<>%ld\n", (bigint)num_read, (bigint)span);
+                    return false;
+                }
+                for (bigint r = 0; r < num_runs; r++) {
+                    mda_convert_data(out + r * out_stride[k + 1] * num_bytes_per_entry, data_type, &d->m_header, run_len, batch_buffer.data() + r * src_stride[k + 1] * d->m_header.num_bytes_per_entry);
+                }
             }
         }
-        return true;
-    }
-    else {
-        printf("Warning: This case not yet supported (diskreadmda::readchunk 3d).\n");
-        return false;
+        //advance to the next run (or span of runs)
+        int dd = k + 1;
+        while (dd < 6) {
+            j[dd] += (dd == k + 1) ? num_runs : 1;
+            if (j[dd] < B[dd])
+                break;
+            j[dd] = A[dd];
+            dd++;
+        }
+        if (dd >= 6)
+            break;
     }
+    return true;
+}
+
+const void* DiskReadMda::mappedDataPtr(bigint i) const
+{
+    if ((d->m_use_memory_mda) || (d->m_use_concat))
+        return 0;
+    if (!d->open_file_if_needed())
+        return 0;
+    if ((i < 0) || (i >= d->total_size()))
+        return 0;
+    if (!d->m_mapped_data)
+        return 0;
+    return d->m_mapped_data + d->m_header.header_size + d->m_header.num_bytes_per_entry * i;
 }
 
 double DiskReadMda::value(bigint i) const
@@ -686,18 +882,23 @@ double DiskReadMda::value(bigint i) const
         return d->m_memory_mda.value(i);
     if ((i < 0) || (i >= d->total_size()))
         return 0;
-    bigint chunk_index = i / DEFAULT_CHUNK_SIZE;
-    bigint offset = i - DEFAULT_CHUNK_SIZE * chunk_index;
-    if (d->m_current_internal_chunk_index != chunk_index) {
-        bigint size_to_read = DEFAULT_CHUNK_SIZE;
-        if (chunk_index * DEFAULT_CHUNK_SIZE + size_to_read > d->total_size())
-            size_to_read = d->total_size() - chunk_index * DEFAULT_CHUNK_SIZE;
-        if (size_to_read) {
-            this->readChunk(d->m_internal_chunk, chunk_index * DEFAULT_CHUNK_SIZE, size_to_read);
-        }
-        d->m_current_internal_chunk_index = chunk_index;
+    bigint block_index = i / VALUE_CACHE_BLOCK_SIZE;
+    {
+        QMutexLocker locker(&d->m_value_mutex);
+        const Mda* block = d->find_value_cache_block(block_index);
+        if (block)
+            return block->value(i - block_index * VALUE_CACHE_BLOCK_SIZE);
     }
-    return d->m_internal_chunk.value(offset);
+    //read the block without the lock, so that a miss does not hold up the other readers of this array
+    if (d->cacheMissesCounter)
+        d->cacheMissesCounter->add(1);
+    bigint size_to_read = qMin((bigint)VALUE_CACHE_BLOCK_SIZE, d->total_size() - block_index * VALUE_CACHE_BLOCK_SIZE);
+    Mda data;
+    if (!readChunk(data, block_index * VALUE_CACHE_BLOCK_SIZE, size_to_read))
+        return 0;
+    QMutexLocker locker(&d->m_value_mutex);
+    const Mda* block = d->insert_value_cache_block(block_index, data);
+    return block->value(i - block_index * VALUE_CACHE_BLOCK_SIZE);
 }
 
 double DiskReadMda::value(bigint i1, bigint i2) const
@@ -727,13 +928,13 @@ double DiskReadMda::value(bigint i1, bigint i2, bigint i3) const
 void DiskReadMdaPrivate::construct_and_clear()
 {
     m_file_open_failed = false;
+    m_mmap_failed = false;
     m_file = 0;
-    m_current_internal_chunk_index = -1;
+    clear_value_cache();
     m_use_memory_mda = false;
     m_use_concat = false;
     m_header_read = false;
     m_reshaped = false;
-    this->m_internal_chunk = Mda();
     this->m_mda_header_total_size = 0;
     this->m_memory_mda = Mda();
     this->m_path = "";
@@ -741,6 +942,7 @@ void DiskReadMdaPrivate::construct_and_clear()
 
 bool DiskReadMdaPrivate::read_header_if_needed()
 {
+    QMutexLocker locker(&m_init_mutex);
     if (m_header_read)
         return true;
     if (m_use_memory_mda) {
@@ -754,23 +956,25 @@ bool DiskReadMdaPrivate::read_header_if_needed()
             return false;
         }
         m_header = m_concat_list[0].mdaioHeader();
-        bigint N2 = 0;
+        int kk = m_concat_dimension - 1;
+        bigint inner_size = 1;
+        for (int dd = 0; dd < kk; dd++)
+            inner_size *= m_concat_list[0].N(dd + 1);
+        m_concat_offsets.clear();
+        m_concat_offsets << 0;
+        bigint Nk = 0;
         for (int i = 0; i < m_concat_list.count(); i++) {
-            if (m_concat_list[i].N1() != m_concat_list[0].N1()) {
-                qWarning() << "dimension mismatch in concat list";
-                return false;
-            }
-            if (m_concat_list[i].N3() != m_concat_list[0].N3()) {
-                qWarning() << "dimension mismatch in concat list";
-                return false;
+            for (int dd = 0; dd < 6; dd++) {
+                if ((dd != kk) && (m_concat_list[i].N(dd + 1) != m_concat_list[0].N(dd + 1))) {
+                    qWarning() << "dimension mismatch in concat list" << i << dd + 1 << m_concat_list[i].N(dd + 1) << m_concat_list[0].N(dd + 1);
+                    return false;
+                }
             }
-            if (m_concat_list[i].N4() != m_concat_list[0].N4()) {
-                qWarning() << "dimension mismatch in concat list";
-                return false;
-            }
-            N2 += m_concat_list[i].N2();
+            Nk += m_concat_list[i].N(kk + 1);
+            m_concat_offsets << m_concat_offsets.last() + inner_size * m_concat_list[i].N(kk + 1);
         }
-        m_header.dims[1] = N2;
+        m_header.dims[kk] = Nk;
+        m_header.num_dims = qMax(m_header.num_dims, kk + 1);
         m_mda_header_total_size = 1;
         for (int i = 0; i < MDAIO_MAX_DIMS; i++)
             m_mda_header_total_size *= m_header.dims[i];
@@ -790,14 +994,17 @@ bool DiskReadMdaPrivate::read_header_if_needed()
 
 bool DiskReadMdaPrivate::open_file_if_needed()
 {
+    QMutexLocker locker(&m_init_mutex);
     if (m_use_memory_mda)
         return true;
     if (m_use_concat) {
         read_header_if_needed();
         return true;
     }
-    if (m_file)
+    if (m_file) {
+        map_file_if_needed();
         return true;
+    }
     if (m_file_open_failed)
         return false;
     if (m_path.isEmpty())
@@ -812,6 +1019,7 @@ bool DiskReadMdaPrivate::open_file_if_needed()
                 m_mda_header_total_size *= m_header.dims[i];
             m_header_read = true;
         }
+        map_file_if_needed();
     }
     else {
         qWarning() << ":::: Failed to open diskreadmda file: " + m_path;
@@ -827,21 +1035,256 @@ bool DiskReadMdaPrivate::open_file_if_needed()
     return true;
 }
 
+bool DiskReadMdaPrivate::map_file_if_needed()
+{
+    if (m_mapped_data)
+        return true;
+    if ((!m_use_mmap) || (m_mmap_failed) || (!m_file))
+        return false;
+    //don't map a truncated file, since touching a page past the end of the file raises SIGBUS
+    struct stat SS;
+    if (fstat(fileno(m_file), &SS) != 0) {
+        m_mmap_failed = true;
+        return false;
+    }
+    bigint expected_size = m_header.header_size + m_header.num_bytes_per_entry * m_mda_header_total_size;
+    if ((!S_ISREG(SS.st_mode)) || ((bigint)SS.st_size < expected_size) || (expected_size == 0)) {
+        m_mmap_failed = true;
+        return false;
+    }
+    void* ptr = mmap(0, SS.st_size, PROT_READ, MAP_SHARED, fileno(m_file), 0);
+    if (ptr == MAP_FAILED) {
+        qWarning() << "Unable to memory-map diskreadmda file, falling back to buffered reads: " + m_path;
+        m_mmap_failed = true;
+        return false;
+    }
+    m_mapped_data = (char*)ptr;
+    m_mapped_size = SS.st_size;
+    return true;
+}
+
+void DiskReadMdaPrivate::close_file()
+{
+    if (m_mapped_data) {
+        munmap(m_mapped_data, m_mapped_size);
+        m_mapped_data = 0;
+        m_mapped_size = 0;
+    }
+    if (m_file) {
+        fclose(m_file);
+        m_file = 0;
+    }
+}
+
+bigint DiskReadMdaPrivate::read_entries(void* data, int data_type, bigint i, bigint n)
+{
+    //the file must already be open (and mapped, if requested) by open_file_if_needed(). Returns the number of entries read
+    if (m_mapped_data) {
+        return mda_convert_data(data, data_type, &m_header, n, m_mapped_data + m_header.header_size + m_header.num_bytes_per_entry * i);
+    }
+    //positional read, so concurrent readers do not compete for the file offset
+    return mda_pread_data(data, data_type, &m_header, n, fileno(m_file), m_header.header_size + m_header.num_bytes_per_entry * i);
+}
+
+struct DiskReadMdaConcatPiece {
+    //input: num_rows rows of row_size entries, contiguous in the segment starting at position i, to be written to data with a stride of out_stride entries between rows
+    const DiskReadMda* array = 0;
+    bigint out_index = 0; //position of data in the output, used while planning
+    void* data = 0;
+    int data_type = MDAIO_TYPE_FLOAT64;
+    bigint i = 0;
+    bigint row_size = 0;
+    bigint num_rows = 1;
+    bigint out_stride = 0;
+
+    //output
+    bool success = false;
+
+    void read()
+    {
+        if (num_rows == 1) {
+            success = array->readRawChunk(data, data_type, i, row_size);
+            return;
+        }
+        bigint num_bytes_per_entry = mda_get_num_bytes_per_entry(data_type);
+        MdaPooledBuffer buf(row_size * num_rows * num_bytes_per_entry, "diskreadmda");
+        success = ((buf.data()) && (array->readRawChunk(buf.data(), data_type, i, row_size * num_rows)));
+        if (!success)
+            return;
+        for (bigint r = 0; r < num_rows; r++) {
+            memcpy((char*)data + r * out_stride * num_bytes_per_entry, buf.data() + r * row_size * num_bytes_per_entry, row_size * num_bytes_per_entry);
+        }
+    }
+};
+
+static void add_concat_pieces_in_slice(QVector<DiskReadMdaConcatPiece>& pieces, const QList<DiskReadMda>& list, const QVector<bigint>& offsets, bigint slice_index, bigint rA, bigint rB, bigint out_index)
+{
+    //pieces covering positions rA..rB-1 of one outer slice, found by binary search in the offset table. out_index is the output position corresponding to rA
+    int ii = std::upper_bound(offsets.begin(), offsets.end(), rA) - offsets.begin() - 1;
+    bigint r = rA;
+    while ((r < rB) && (ii < list.count())) {
+        bigint block_size = offsets[ii + 1] - offsets[ii];
+        if (offsets[ii + 1] > r) {
+            DiskReadMdaConcatPiece P;
+            P.array = &list.at(ii);
+            P.out_index = out_index + (r - rA);
+            P.i = slice_index * block_size + (r - offsets[ii]);
+            P.row_size = qMin(offsets[ii + 1], rB) - r;
+            pieces << P;
+            r += P.row_size;
+        }
+        ii++;
+    }
+}
+
+bool DiskReadMdaPrivate::read_concat_entries(void* data, int data_type, bigint i, bigint n)
+{
+    //entries i..i+n-1 must lie inside the array and the header must have been read
+    //each segment contributes a contiguous block of entries to every outer slice (see m_concat_offsets). A partial slice at either end of the range is read piece by piece, directly into the output. The complete slices in between are read with a single contiguous read per segment, and the blocks are then scattered into place
+    bigint num_bytes_per_entry = mda_get_num_bytes_per_entry(data_type);
+    bigint slice_size = m_concat_offsets.last();
+    if (slice_size <= 0)
+        return false;
+    QVector<DiskReadMdaConcatPiece> pieces;
+    bigint sA = i / slice_size, sB = (i + n) / slice_size; //the complete slices are sA..sB-1, after adjusting for a partial first slice
+    if (i % slice_size != 0) {
+        bigint rB = (sA == sB) ? (i + n) % slice_size : slice_size;
+        add_concat_pieces_in_slice(pieces, m_concat_list, m_concat_offsets, sA, i % slice_size, rB, 0);
+        sA++;
+    }
+    if (sB > sA) {
+        for (int ii = 0; ii < m_concat_list.count(); ii++) {
+            bigint block_size = m_concat_offsets[ii + 1] - m_concat_offsets[ii];
+            if (block_size == 0)
+                continue;
+            DiskReadMdaConcatPiece P;
+            P.array = &m_concat_list.at(ii);
+            P.out_index = sA * slice_size + m_concat_offsets[ii] - i;
+            P.i = sA * block_size;
+            P.row_size = block_size;
+            P.num_rows = sB - sA;
+            P.out_stride = slice_size;
+            pieces << P;
+        }
+    }
+    if ((sB >= sA) && ((i + n) % slice_size != 0)) {
+        add_concat_pieces_in_slice(pieces, m_concat_list, m_concat_offsets, sB, 0, (i + n) % slice_size, sB * slice_size - i);
+    }
+    bigint num_pieces_entries = 0;
+    for (int j = 0; j < pieces.count(); j++) {
+        pieces[j].data = (char*)data + pieces[j].out_index * num_bytes_per_entry;
+        pieces[j].data_type = data_type;
+        num_pieces_entries += pieces[j].row_size * pieces[j].num_rows;
+    }
+
+    //a range that spans several segments usually spans several files, so large reads are done in parallel on the threads of the global pool, each thread taking the next piece. Smaller reads are done right here, piece by piece
+    bool parallel = ((pieces.count() > 1) && (n * num_bytes_per_entry >= MIN_PARALLEL_CONCAT_READ_BYTES));
+    if (!parallel) {
+        for (int j = 0; j < pieces.count(); j++)
+            pieces[j].read();
+    }
+    else {
+        std::atomic<int> next_piece(0);
+        MdaMemoryBudget::Policy budget_policy = MdaMemoryBudget::threadPolicy(); //that of the thread doing the read
+        auto read_pieces = [&]() {
+            //pool threads are shared, so their own policy is put back afterwards
+            MdaMemoryBudget::Policy previous_policy = MdaMemoryBudget::threadPolicy();
+            MdaMemoryBudget::setThreadPolicy(budget_policy);
+            for (int j = next_piece++; j < pieces.count(); j = next_piece++)
+                pieces[j].read();
+            MdaMemoryBudget::setThreadPolicy(previous_policy);
+        };
+        QList<std::function<void()> > tasks;
+        int num_threads = qMin(qMax(1, QThread::idealThreadCount()), pieces.count());
+        for (int j = 0; j < num_threads; j++)
+            tasks << read_pieces;
+        run_in_threads(tasks);
+    }
+    bool ret = (num_pieces_entries == n);
+    for (int j = 0; j < pieces.count(); j++) {
+        if (!pieces[j].success) {
+            qWarning() << "Problem reading segment of concatenated array" << pieces[j].i << pieces[j].row_size << pieces[j].num_rows;
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+const Mda* DiskReadMdaPrivate::find_value_cache_block(bigint block_index)
+{
+    //m_value_mutex must be locked. Returns 0 if the block is not in the cache
+    if ((!m_value_cache.empty()) && (m_value_cache.front().index == block_index)) {
+        m_value_cache_hits++;
+        return &m_value_cache.front().data;
+    }
+    if (m_value_cache_index.contains(block_index)) {
+        std::list<CacheBlock>::iterator it = m_value_cache_index[block_index];
+        m_value_cache.splice(m_value_cache.begin(), m_value_cache, it);
+        m_value_cache_hits++;
+        return &m_value_cache.front().data;
+    }
+    return 0;
+}
+
+const Mda* DiskReadMdaPrivate::insert_value_cache_block(bigint block_index, const Mda& data)
+{
+    //m_value_mutex must be locked
+    flush_cache_hits();
+    if (m_value_cache_index.contains(block_index)) {
+        //another thread read the same block in the meantime
+        std::list<CacheBlock>::iterator it = m_value_cache_index[block_index];
+        m_value_cache.splice(m_value_cache.begin(), m_value_cache, it);
+        return &m_value_cache.front().data;
+    }
+    //make room, reusing the least recently used block if the cache is full
+    bigint max_blocks = qMax((bigint)1, m_value_cache_size / (VALUE_CACHE_BLOCK_SIZE * (bigint)sizeof(double)));
+    while ((bigint)m_value_cache.size() >= max_blocks) {
+        m_value_cache_index.remove(m_value_cache.back().index);
+        m_value_cache.pop_back();
+        if (cacheEvictionsCounter)
+            cacheEvictionsCounter->add(1);
+    }
+    CacheBlock block;
+    block.index = block_index;
+    block.data = data;
+    m_value_cache.push_front(block);
+    m_value_cache_index[block_index] = m_value_cache.begin();
+    return &m_value_cache.front().data;
+}
+
+void DiskReadMdaPrivate::clear_value_cache()
+{
+    m_value_cache.clear();
+    m_value_cache_index.clear();
+}
+
+void DiskReadMdaPrivate::flush_cache_hits()
+{
+    //hits are counted locally and added in bulk, since value() is called far too often to update a counter each time
+    if ((cacheHitsCounter) && (m_value_cache_hits))
+        cacheHitsCounter->add(m_value_cache_hits);
+    m_value_cache_hits = 0;
+}
+
 void DiskReadMdaPrivate::copy_from(const DiskReadMda& other)
 {
     /// TODO (LOW) think about copying over additional information such as internal chunks
 
-    if (this->m_file) {
-        fclose(this->m_file);
-        this->m_file = 0;
-    }
+    this->flush_cache_hits();
+    this->close_file();
+    QMutexLocker locker(&other.d->m_init_mutex);
     this->allocatedCounter = other.d->allocatedCounter;
     this->freedCounter = other.d->freedCounter;
     this->bytesReadCounter = other.d->bytesReadCounter;
     this->bytesWrittenCounter = other.d->bytesWrittenCounter;
     this->construct_and_clear();
-    this->m_current_internal_chunk_index = -1;
+    this->m_value_cache_size = other.d->m_value_cache_size;
+    this->cacheHitsCounter = other.d->cacheHitsCounter;
+    this->cacheMissesCounter = other.d->cacheMissesCounter;
+    this->cacheEvictionsCounter = other.d->cacheEvictionsCounter;
     this->m_file_open_failed = other.d->m_file_open_failed;
+    this->m_use_mmap = other.d->m_use_mmap;
+    this->m_mmap_failed = false;
     this->m_header = other.d->m_header;
     this->m_header_read = other.d->m_header_read;
     this->m_mda_header_total_size = other.d->m_mda_header_total_size;
@@ -853,6 +1296,7 @@ void DiskReadMdaPrivate::copy_from(const DiskReadMda& other)
     this->m_use_concat = other.d->m_use_concat;
     this->m_concat_dimension = other.d->m_concat_dimension;
     this->m_concat_list = other.d->m_concat_list;
+    this->m_concat_offsets = other.d->m_concat_offsets;
 }
 
 bigint DiskReadMdaPrivate::total_size()
@@ -864,6 +1308,126 @@ bigint DiskReadMdaPrivate::total_size()
     return m_mda_header_total_size;
 }
 
+struct DiskReadMdaPrefetchedChunk {
+    Mda chunk;
+    bigint start = 0;
+    bigint size = 0;
+    bool success = false;
+};
+
+class DiskReadMdaPrefetchThread : public QThread {
+public:
+    //input
+    DiskReadMda array;
+    bigint chunk_size = 0;
+    bigint overlap = 0;
+    int num_prefetch = 2;
+    MdaMemoryBudget::Policy budget_policy = MdaMemoryBudget::threadPolicy(); //that of the thread creating the iterator
+
+    //shared with the iterator, guarded by mutex
+    QMutex mutex;
+    QWaitCondition chunk_ready;
+    QWaitCondition space_available;
+    QQueue<DiskReadMdaPrefetchedChunk> queue;
+    bool finished = false;
+    bool stop_requested = false;
+
+    void run()
+    {
+        MdaMemoryBudget::setThreadPolicy(budget_policy);
+        bigint N1 = array.N1();
+        bigint M = (N1 > 0) ? array.totalSize() / N1 : 0;
+        for (bigint start = 0; start < M; start += chunk_size) {
+            {
+                QMutexLocker locker(&mutex);
+                while ((queue.count() >= num_prefetch) && (!stop_requested))
+                    space_available.wait(&mutex);
+                if (stop_requested)
+                    break;
+            }
+            DiskReadMdaPrefetchedChunk C;
+            C.start = start;
+            C.size = qMin(chunk_size, M - start);
+            C.success = array.readChunk(C.chunk, 0, start - overlap, N1, C.size + 2 * overlap);
+            QMutexLocker locker(&mutex);
+            queue.enqueue(C);
+            chunk_ready.wakeAll();
+            if (!C.success)
+                break;
+        }
+        QMutexLocker locker(&mutex);
+        finished = true;
+        chunk_ready.wakeAll();
+    }
+};
+
+class DiskReadMdaChunkIteratorPrivate {
+public:
+    DiskReadMdaChunkIterator* q;
+    DiskReadMdaPrefetchThread m_thread;
+    DiskReadMdaPrefetchedChunk m_current;
+};
+
+DiskReadMdaChunkIterator::DiskReadMdaChunkIterator(const DiskReadMda& X, bigint chunk_size, bigint overlap, int num_prefetch)
+{
+    d = new DiskReadMdaChunkIteratorPrivate;
+    d->q = this;
+    d->m_thread.array = X;
+    d->m_thread.chunk_size = qMax(chunk_size, (bigint)1);
+    d->m_thread.overlap = qMax(overlap, (bigint)0);
+    d->m_thread.num_prefetch = qMax(num_prefetch, 1);
+    d->m_thread.start();
+}
+
+DiskReadMdaChunkIterator::~DiskReadMdaChunkIterator()
+{
+    {
+        QMutexLocker locker(&d->m_thread.mutex);
+        d->m_thread.stop_requested = true;
+        d->m_thread.space_available.wakeAll();
+    }
+    d->m_thread.wait();
+    delete d;
+}
+
+bool DiskReadMdaChunkIterator::next()
+{
+    QMutexLocker locker(&d->m_thread.mutex);
+    while ((d->m_thread.queue.isEmpty()) && (!d->m_thread.finished))
+        d->m_thread.chunk_ready.wait(&d->m_thread.mutex);
+    if (d->m_thread.queue.isEmpty()) {
+        d->m_current = DiskReadMdaPrefetchedChunk();
+        return false;
+    }
+    d->m_current = d->m_thread.queue.dequeue();
+    d->m_thread.space_available.wakeAll();
+    if (!d->m_current.success) {
+        qWarning() << "Problem reading chunk in DiskReadMdaChunkIterator" << d->m_current.start << d->m_current.size;
+        return false;
+    }
+    return true;
+}
+
+const Mda& DiskReadMdaChunkIterator::chunk() const
+{
+    return d->m_current.chunk;
+}
+
+bigint DiskReadMdaChunkIterator::chunkStart() const
+{
+    return d->m_current.start;
+}
+
+bigint DiskReadMdaChunkIterator::chunkSize() const
+{
+    return d->m_current.size;
+}
+
+bigint DiskReadMdaChunkIterator::overlap() const
+{
+    return d->m_thread.overlap;
+}
+
 void diskreadmda_unit_test()
 {
     printf("diskreadmda_unit_test...\n");
@@ -940,6 +1504,59 @@ void diskreadmda_unit_test()
     }
     printf("The following should match (from diskreadmda):\n");
     printf("%.20f\n", sum5);
+
+    DiskReadMda Z2;
+    Z2.setUseMmap(true);
+    Z2.setPath("tmp_64.mda");
+    double sum6 = 0;
+    Mda chunk;
+    Z2.readChunk(chunk, 0, 0, 0, N1, N2, N3);
+    for (bigint i = 0; i < chunk.totalSize(); i++) {
+        sum6 += chunk.value(i);
+    }
+    printf("The following should match (from memory-mapped diskreadmda):\n");
+    printf("%.20f\n", sum6);
+
+    DiskReadMda Z3("tmp_32.mda");
+    QVector<float> buf(N1 * N2 * N3);
+    Z3.readChunk(MdaView<float>(buf.data(), N1, N2, N3), 0);
+    double sum7 = 0;
+    for (bigint i = 0; i < buf.count(); i++) {
+        sum7 += buf[i];
+    }
+    printf("The following should almost match up to 6 or so digits (typed read from diskreadmda):\n");
+    printf("%.20f\n", sum7);
+
+    Mda sub;
+    Z.readChunk(sub, 2, 3, 1, 4, 7, 3);
+    bigint num_mismatches = 0;
+    for (bigint i3 = 0; i3 < 3; i3++) {
+        for (bigint i2 = 0; i2 < 7; i2++) {
+            for (bigint i1 = 0; i1 < 4; i1++) {
+                if (sub.value(i1, i2, i3) != X.value(2 + i1, 3 + i2, 1 + i3))
+                    num_mismatches++;
+            }
+        }
+    }
+    printf("Number of mismatches in sub-rectangle read from diskreadmda (should be 0): %ld\n", num_mismatches);
+
+    QList<DiskReadMda> parts;
+    parts << Z << DiskReadMda("tmp_32.mda");
+    DiskReadMda Z4(1, parts);
+    Mda stacked;
+    Z4.readChunk(stacked, 0, 0, 0, 2 * N1, N2, N3);
+    bigint num_mismatches_2 = 0;
+    for (bigint i3 = 0; i3 < N3; i3++) {
+        for (bigint i2 = 0; i2 < N2; i2++) {
+            for (bigint i1 = 0; i1 < N1; i1++) {
+                if (stacked.value(i1, i2, i3) != X.value(i1, i2, i3))
+                    num_mismatches_2++;
+                if (stacked.value(N1 + i1, i2, i3) != (double)(float)X.value(i1, i2, i3))
+                    num_mismatches_2++;
+            }
+        }
+    }
+    printf("Number of mismatches in array concatenated along the first dimension (should be 0): %ld\n", num_mismatches_2);
 }
 
 QStringList DiskReadMdaPrivate::find_all_mda_files_in_directory(QString dir_path, bool recursive)
@@ -21,6 +21,16 @@
 #include <mda32.h>
 #include "mda.h"
 #include <QDebug>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define DEFAULT_MAX_PENDING_BYTES (256 * 1024 * 1024)
+
+class DiskWriteMdaWorker;
 
 class DiskWriteMdaPrivate {
 public:
@@ -29,8 +39,46 @@ public:
     MDAIO_HEADER m_header;
     FILE* m_file;
     bool m_requires_rename = false;
+    bool m_preallocate = false;
+    bool m_sync_on_close = false;
+
+    //background writing. A queued chunk holds a (copy-on-write) reference to the caller's array
+    struct PendingChunk {
+        Mda X;
+        Mda32 X32;
+        bool use_32 = false;
+        bigint i = 0;
+        bigint num_bytes = 0;
+    };
+    int m_num_write_threads = 0;
+    bigint m_max_pending_bytes = DEFAULT_MAX_PENDING_BYTES;
+    QList<DiskWriteMdaWorker*> m_workers;
+    QMutex m_queue_mutex;
+    QWaitCondition m_chunk_available;
+    QWaitCondition m_chunk_done;
+    QQueue<PendingChunk> m_queue;
+    bigint m_pending_bytes = 0; //queued or being written
+    int m_num_writing = 0;
+    bool m_stop_workers = false;
+    bool m_write_failed = false;
 
     int determine_ndims(bigint N1, bigint N2, bigint N3, bigint N4, bigint N5, bigint N6);
+    bigint total_size();
+    bool write_entries(const void* data, int data_type, bigint i, bigint n);
+    bool write_pending_chunk(const PendingChunk& C);
+    bool enqueue(const PendingChunk& C);
+    void start_workers_if_needed();
+    void stop_workers();
+    void worker_loop();
+};
+
+class DiskWriteMdaWorker : public QThread {
+public:
+    DiskWriteMdaPrivate* d;
+    void run()
+    {
+        d->worker_loop();
+    }
 };
 
 DiskWriteMda::DiskWriteMda()
@@ -51,6 +99,7 @@ DiskWriteMda::DiskWriteMda(int data_type, const QString& path, bigint N1, bigint
 DiskWriteMda::~DiskWriteMda()
 {
     close();
+    d->stop_workers();
     delete d;
 }
 
@@ -83,6 +132,7 @@ bool DiskWriteMda::open(int data_type, const QString& path, bigint N1, bigint N2
 
     d->m_file = fopen((path + ".tmp").toLatin1().data(), "wb");
     d->m_requires_rename = true;
+    d->m_write_failed = false;
 
     if (!d->m_file) {
         qWarning() << "Error in DiskWriteMda::open -- problem in fopen: " + path + ".tmp";
@@ -111,9 +161,25 @@ bool DiskWriteMda::open(int data_type, const QString& path, bigint N1, bigint N2
     free(zeros);
     */
 
-    fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * NN - 1, SEEK_SET);
-    unsigned char zero = 0;
-    fwrite(&zero, 1, 1, d->m_file);
+    bigint file_size = d->m_header.header_size + d->m_header.num_bytes_per_entry * NN;
+    bool allocated = false;
+#ifdef __linux__
+    if (d->m_preallocate) {
+        fflush(d->m_file);
+        int err = posix_fallocate(fileno(d->m_file), 0, file_size);
+        if (err == 0)
+            allocated = true;
+        else
+            qWarning() << "Unable to preallocate file in DiskWriteMda::open" << path << file_size << err;
+    }
+#endif
+    if (!allocated) {
+        fseeko(d->m_file, file_size - 1, SEEK_SET);
+        unsigned char zero = 0;
+        fwrite(&zero, 1, 1, d->m_file);
+    }
+    //chunks are written with pwrite on the underlying descriptor, so nothing may remain in the stdio buffer
+    fflush(d->m_file);
 
     return true;
 }
@@ -126,11 +192,11 @@ bool DiskWriteMda::open(const QString& path)
     d->m_path = path;
 
     d->m_requires_rename = false;
+    d->m_write_failed = false;
     d->m_file = fopen(path.toLatin1().data(), "r+"); //open file for update, both read and write
-    mda_read_header(&d->m_header, d->m_file);
-
     if (!d->m_file)
         return false;
+    mda_read_header(&d->m_header, d->m_file);
 
     return true;
 }
@@ -138,6 +204,10 @@ bool DiskWriteMda::open(const QString& path)
 void DiskWriteMda::close()
 {
     if (d->m_file) {
+        if (!flush())
+            qWarning() << "Some chunks could not be written in DiskWriteMda" << d->m_path;
+        if (d->m_sync_on_close)
+            fsync(fileno(d->m_file));
         fclose(d->m_file);
         if (d->m_requires_rename) {
             if (!QFile::rename(d->m_path + ".tmp", d->m_path)) {
@@ -148,6 +218,52 @@ void DiskWriteMda::close()
     }
 }
 
+void DiskWriteMda::setNumWriteThreads(int num)
+{
+    if (num == d->m_num_write_threads)
+        return;
+    flush();
+    d->stop_workers();
+    d->m_num_write_threads = qMax(num, 0);
+}
+
+void DiskWriteMda::setMaxPendingBytes(bigint num_bytes)
+{
+    QMutexLocker locker(&d->m_queue_mutex);
+    d->m_max_pending_bytes = num_bytes;
+    d->m_chunk_done.wakeAll();
+}
+
+void DiskWriteMda::setPreallocate(bool val)
+{
+    d->m_preallocate = val;
+}
+
+void DiskWriteMda::setSyncOnClose(bool val)
+{
+    d->m_sync_on_close = val;
+}
+
+bool DiskWriteMda::flush()
+{
+    QMutexLocker locker(&d->m_queue_mutex);
+    while ((!d->m_queue.isEmpty()) || (d->m_num_writing > 0))
+        d->m_chunk_done.wait(&d->m_queue_mutex);
+    return !d->m_write_failed;
+}
+
+bool DiskWriteMda::sync()
+{
+    if (!d->m_file)
+        return false;
+    bool ret = flush();
+    if (fsync(fileno(d->m_file)) != 0) {
+        qWarning() << "Problem in fsync in DiskWriteMda" << d->m_path;
+        ret = false;
+    }
+    return ret;
+}
+
 bigint DiskWriteMda::N1()
 {
     if (!d->m_file)
@@ -199,12 +315,18 @@ bool DiskWriteMda::writeChunk(Mda& X, bigint i)
 {
     if (!d->m_file)
         return false;
-    fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * i, SEEK_SET);
     bigint size = X.totalSize();
-    if (i + size > this->totalSize())
-        size = this->totalSize() - i;
+    if (i + size > d->total_size())
+        size = d->total_size() - i;
     if (size > 0) {
-        if (!mda_write_float64(X.dataPtr(), &d->m_header, size, d->m_file))
+        if (d->m_num_write_threads > 0) {
+            DiskWriteMdaPrivate::PendingChunk C;
+            C.X = X;
+            C.i = i;
+            C.num_bytes = size * sizeof(double);
+            return d->enqueue(C);
+        }
+        if (!d->write_entries(X.constDataPtr(), MDAIO_TYPE_FLOAT64, i, size))
             return false;
     }
     return true;
@@ -239,12 +361,19 @@ bool DiskWriteMda::writeChunk(Mda32& X, bigint i)
 {
     if (!d->m_file)
         return false;
-    fseeko(d->m_file, d->m_header.header_size + d->m_header.num_bytes_per_entry * i, SEEK_SET);
     bigint size = X.totalSize();
-    if (i + size > this->totalSize())
-        size = this->totalSize() - i;
+    if (i + size > d->total_size())
+        size = d->total_size() - i;
     if (size > 0) {
-        return mda_write_float32(X.dataPtr(), &d->m_header, size, d->m_file);
+        if (d->m_num_write_threads > 0) {
+            DiskWriteMdaPrivate::PendingChunk C;
+            C.X32 = X;
+            C.use_32 = true;
+            C.i = i;
+            C.num_bytes = size * sizeof(dtype32);
+            return d->enqueue(C);
+        }
+        return d->write_entries(X.constDataPtr(), MDAIO_TYPE_FLOAT32, i, size);
     }
     else {
         qWarning() << "size is zero in writeChunk";
@@ -293,3 +422,97 @@ int DiskWriteMdaPrivate::determine_ndims(bigint N1, bigint N2, bigint N3, bigint
         return 3;
     return 2;
 }
+
+bigint DiskWriteMdaPrivate::total_size()
+{
+    if (!m_file)
+        return 0;
+    bigint ret = 1;
+    for (int i = 0; i < 6; i++)
+        ret *= m_header.dims[i];
+    return ret;
+}
+
+bool DiskWriteMdaPrivate::write_entries(const void* data, int data_type, bigint i, bigint n)
+{
+    //positional write, so concurrent writers of disjoint regions do not compete for the file offset
+    bigint num_written = mda_pwrite_data(data, data_type, &m_header, n, fileno(m_file), m_header.header_size + m_header.num_bytes_per_entry * i);
+    if (num_written != n) {
+        qWarning() << "Problem writing chunk in DiskWriteMda" << m_path << i << n << num_written;
+        return false;
+    }
+    return true;
+}
+
+bool DiskWriteMdaPrivate::write_pending_chunk(const PendingChunk& C)
+{
+    //the chunk was already clipped to the array when it was queued
+    if (C.use_32)
+        return write_entries(C.X32.constDataPtr(), MDAIO_TYPE_FLOAT32, C.i, C.num_bytes / sizeof(dtype32));
+    else
+        return write_entries(C.X.constDataPtr(), MDAIO_TYPE_FLOAT64, C.i, C.num_bytes / sizeof(double));
+}
+
+bool DiskWriteMdaPrivate::enqueue(const PendingChunk& C)
+{
+    start_workers_if_needed();
+    QMutexLocker locker(&m_queue_mutex);
+    //always admit one chunk, even if it alone exceeds the limit
+    while ((m_pending_bytes > 0) && (m_pending_bytes + C.num_bytes > m_max_pending_bytes))
+        m_chunk_done.wait(&m_queue_mutex);
+    m_queue.enqueue(C);
+    m_pending_bytes += C.num_bytes;
+    m_chunk_available.wakeOne();
+    return !m_write_failed;
+}
+
+void DiskWriteMdaPrivate::start_workers_if_needed()
+{
+    QMutexLocker locker(&m_queue_mutex);
+    if (!m_workers.isEmpty())
+        return;
+    m_stop_workers = false;
+    for (int i = 0; i < m_num_write_threads; i++) {
+        DiskWriteMdaWorker* W = new DiskWriteMdaWorker;
+        W->d = this;
+        W->start();
+        m_workers << W;
+    }
+}
+
+void DiskWriteMdaPrivate::stop_workers()
+{
+    {
+        QMutexLocker locker(&m_queue_mutex);
+        m_stop_workers = true;
+        m_chunk_available.wakeAll();
+    }
+    foreach (DiskWriteMdaWorker* W, m_workers) {
+        W->wait();
+        delete W;
+    }
+    m_workers.clear();
+}
+
+void DiskWriteMdaPrivate::worker_loop()
+{
+    QMutexLocker locker(&m_queue_mutex);
+    while (true) {
+        while ((m_queue.isEmpty()) && (!m_stop_workers))
+            m_chunk_available.wait(&m_queue_mutex);
+        if (m_queue.isEmpty())
+            return;
+        PendingChunk C = m_queue.dequeue();
+        m_num_writing++;
+        locker.unlock();
+        bool ok = write_pending_chunk(C);
+        bigint num_bytes = C.num_bytes;
+        C = PendingChunk(); //release our reference before reporting the chunk as done
+        locker.relock();
+        m_num_writing--;
+        m_pending_bytes -= num_bytes;
+        if (!ok)
+            m_write_failed = true;
+        m_chunk_done.wakeAll();
+    }
+}
@@ -70,15 +70,36 @@ void Mda::operator=(const Mda& other)
     d = other.d;
 }
 
+Mda::Mda(Mda&& other)
+{
+    d = new MdaDataDouble;
+    d.swap(other.d);
+}
+
+void Mda::operator=(Mda&& other)
+{
+    d.swap(other.d);
+}
+
 Mda::~Mda()
 {
 }
 
 bool Mda::allocate(bigint N1, bigint N2, bigint N3, bigint N4, bigint N5, bigint N6)
 {
+    //the old contents are about to be discarded, so if they are shared, start afresh rather than detaching (which would copy them)
+    if (d.constData()->ref.load() > 1)
+        d = new MdaDataDouble;
     return d->allocate(0, N1, N2, N3, N4, N5, N6);
 }
 
+bool Mda::allocateUninitialized(bigint N1, bigint N2, bigint N3, bigint N4, bigint N5, bigint N6)
+{
+    if (d.constData()->ref.load() > 1)
+        d = new MdaDataDouble;
+    return d->allocateUninitialized(N1, N2, N3, N4, N5, N6);
+}
+
 bool Mda::allocateFill(double value, bigint N1, bigint N2, bigint N3, bigint N4, bigint N5, bigint N6)
 {
     return d->allocate(value, N1, N2, N3, N4, N5, N6);
@@ -219,8 +240,15 @@ bool Mda::read(const char* path)
         *this = Mda(1);
         return false;
     }
-    this->allocate(H.dims[0], H.dims[1], H.dims[2], H.dims[3], H.dims[4], H.dims[5]);
-    mda_read_float64(d->data(), &H, d->totalSize(), input_file);
+    if (!this->allocateUninitialized(H.dims[0], H.dims[1], H.dims[2], H.dims[3], H.dims[4], H.dims[5])) {
+        fclose(input_file);
+        return false;
+    }
+    bigint num_read = mda_read_float64(d->data(), &H, d->totalSize(), input_file);
+    if (num_read < d->totalSize()) {
+        qWarning() << "Unexpected end of mda file: " + QString(path) << num_read << d->totalSize();
+        std::fill(d->data() + qMax(num_read, (bigint)0), d->data() + d->totalSize(), 0);
+    }
     d->incrementBytesReadCounter(d->totalSize() * H.num_bytes_per_entry);
     fclose(input_file);
     return true;
@@ -491,6 +519,16 @@ const double* Mda::constDataPtr() const
     return d->constData();
 }
 
+MdaView<double> Mda::view()
+{
+    return MdaView<double>(dataPtr(), N1(), N2(), N3(), N4(), N5(), N6());
+}
+
+MdaView<const double> Mda::constView() const
+{
+    return MdaView<const double>(constDataPtr(), N1(), N2(), N3(), N4(), N5(), N6());
+}
+
 double* Mda::dataPtr(bigint i)
 {
     return d->data() + i;
@@ -518,132 +556,38 @@ double* Mda::dataPtr(bigint i1, bigint i2, bigint i3, bigint i4, bigint i5, bigi
 
 void Mda::getChunk(Mda& ret, bigint i, bigint size) const
 {
-    // A lot of bugs fixed on 5/31/16
-    bigint a_begin = i;
-    bigint x_begin = 0;
-    bigint a_end = i + size - 1;
-    //    bigint x_end = size - 1;  // unused?
-
-    if (a_begin < 0) {
-        x_begin += 0 - a_begin;
-        a_begin += 0 - a_begin;
-    }
-    if (a_end >= (bigint)d->totalSize()) {
-        //        x_end += (bigint)d->totalSize() - 1 - a_end; // unused?
-        a_end += (bigint)d->totalSize() - 1 - a_end;
-    }
-
-    ret.allocate(1, size);
-
-    const double* ptr1 = this->constDataPtr();
-    double* ptr2 = ret.dataPtr();
-
-    std::copy(ptr1 + a_begin, ptr1 + a_end + 1, ptr2 + x_begin);
+    if (!ret.allocateUninitialized(1, size))
+        return;
+    getChunk(ret.view(), i);
 }
 
 void Mda::getChunk(Mda& ret, bigint i1, bigint i2, bigint size1, bigint size2) const
 {
-    // A lot of bugs fixed on 5/31/16
-    bigint a1_begin = i1;
-    bigint x1_begin = 0;
-    bigint a1_end = i1 + size1 - 1;
-    bigint x1_end = size1 - 1;
-    if (a1_begin < 0) {
-        x1_begin += 0 - a1_begin;
-        a1_begin += 0 - a1_begin;
-    }
-    if (a1_end >= N1()) {
-        x1_end += N1() - 1 - a1_end;
-        a1_end += N1() - 1 - a1_end;
-    }
-
-    bigint a2_begin = i2;
-    bigint x2_begin = 0;
-    bigint a2_end = i2 + size2 - 1;
-    bigint x2_end = size2 - 1;
-    if (a2_begin < 0) {
-        x2_begin += 0 - a2_begin;
-        a2_begin += 0 - a2_begin;
-    }
-    if (a2_end >= N2()) {
-        x2_end += N2() - 1 - a2_end;
-        a2_end += N2() - 1 - a2_end;
-    }
-
-    ret.allocate(size1, size2);
-
-    const double* ptr1 = this->constDataPtr();
-    double* ptr2 = ret.dataPtr();
-
-    for (bigint ind2 = 0; ind2 <= a2_end - a2_begin; ind2++) {
-        bigint ii_out = (ind2 + x2_begin) * size1 + x1_begin; //bug fixed on 5/31/16 by jfm
-        bigint ii_in = (ind2 + a2_begin) * N1() + a1_begin; //bug fixed on 5/31/16 by jfm
-        for (bigint ind1 = 0; ind1 <= a1_end - a1_begin; ind1++) {
-            ptr2[ii_out] = ptr1[ii_in];
-            ii_in++;
-            ii_out++;
-        }
-    }
+    if (!ret.allocateUninitialized(size1, size2))
+        return;
+    getChunk(ret.view(), i1, i2);
 }
 
 void Mda::getChunk(Mda& ret, bigint i1, bigint i2, bigint i3, bigint size1, bigint size2, bigint size3) const
 {
-    // A lot of bugs fixed on 5/31/16
-    bigint a1_begin = i1;
-    bigint x1_begin = 0;
-    bigint a1_end = i1 + size1 - 1;
-    bigint x1_end = size1 - 1;
-    if (a1_begin < 0) {
-        x1_begin += 0 - a1_begin;
-        a1_begin += 0 - a1_begin;
-    }
-    if (a1_end >= N1()) {
-        x1_end += N1() - 1 - a1_end;
-        a1_end += N1() - 1 - a1_end;
-    }
-
-    bigint a2_begin = i2;
-    bigint x2_begin = 0;
-    bigint a2_end = i2 + size2 - 1;
-    bigint x2_end = size2 - 1;
-    if (a2_begin < 0) {
-        x2_begin += 0 - a2_begin;
-        a2_begin += 0 - a2_begin;
-    }
-    if (a2_end >= N2()) {
-        x2_end += N2() - 1 - a2_end;
-        a2_end += N2() - 1 - a2_end;
-    }
-
-    bigint a3_begin = i3;
-    bigint x3_begin = 0;
-    bigint a3_end = i3 + size3 - 1;
-    bigint x3_end = size3 - 1;
-    if (a3_begin < 0) {
-        x3_begin += 0 - a3_begin;
-        a3_begin += 0 - a3_begin;
-    }
-    if (a3_end >= N3()) {
-        x3_end += N3() - 1 - a3_end;
-        a3_end += N3() - 1 - a3_end;
-    }
+    if (!ret.allocateUninitialized(size1, size2, size3))
+        return;
+    getChunk(ret.view(), i1, i2, i3);
+}
 
-    ret.allocate(size1, size2, size3);
+void Mda::getChunk(const MdaView<double>& ret, bigint i) const
+{
+    mda_copy_chunk(ret.data(), ret.totalSize(), (bigint)1, (bigint)1, d->constData(), d->totalSize(), (bigint)1, (bigint)1, i, (bigint)0, (bigint)0);
+}
 
-    const double* ptr1 = this->constDataPtr();
-    double* ptr2 = ret.dataPtr();
+void Mda::getChunk(const MdaView<double>& ret, bigint i1, bigint i2) const
+{
+    mda_copy_chunk(ret.data(), ret.N1(), ret.N2(), (bigint)1, d->constData(), N1(), N2(), (bigint)1, i1, i2, (bigint)0);
+}
 
-    for (bigint ind3 = 0; ind3 <= a3_end - a3_begin; ind3++) {
-        for (bigint ind2 = 0; ind2 <= a2_end - a2_begin; ind2++) {
-            bigint ii_out = x1_begin + (ind2 + x2_begin) * size1 + (ind3 + x3_begin) * size1 * size2; //bug fixed on 5/31/16 by jfm
-            bigint ii_in = a1_begin + (ind2 + a2_begin) * N1() + (ind3 + a3_begin) * N1() * N2(); //bug fixed on 5/31/16 by jfm
-            for (bigint ind1 = 0; ind1 <= a1_end - a1_begin; ind1++) {
-                ptr2[ii_out] = ptr1[ii_in];
-                ii_in++;
-                ii_out++;
-            }
-        }
-    }
+void Mda::getChunk(const MdaView<double>& ret, bigint i1, bigint i2, bigint i3) const
+{
+    mda_copy_chunk(ret.data(), ret.N1(), ret.N2(), ret.N3(), d->constData(), N1(), N2(), N3(), i1, i2, i3);
 }
 
 void Mda::setChunk(Mda& X, bigint i)
@@ -665,7 +609,7 @@ void Mda::setChunk(Mda& X, bigint i)
     }
 
     double* ptr1 = this->dataPtr();
-    double* ptr2 = X.dataPtr();
+    const double* ptr2 = X.constDataPtr();
 
     bigint ii = 0;
     for (bigint a = a_begin; a <= a_end; a++) {
@@ -706,7 +650,7 @@ void Mda::setChunk(Mda& X, bigint i1, bigint i2)
     }
 
     double* ptr1 = this->dataPtr();
-    double* ptr2 = X.dataPtr();
+    const double* ptr2 = X.constDataPtr();
 
     for (bigint ind2 = 0; ind2 <= a2_end - a2_begin; ind2++) {
         bigint ii_out = (ind2 + x2_begin) * size1;
@@ -765,7 +709,7 @@ void Mda::setChunk(Mda& X, bigint i1, bigint i2, bigint i3)
     }
 
     double* ptr1 = this->dataPtr();
-    double* ptr2 = X.dataPtr();
+    const double* ptr2 = X.constDataPtr();
 
     for (bigint ind3 = 0; ind3 <= a3_end - a3_begin; ind3++) {
         for (bigint ind2 = 0; ind2 <= a2_end - a2_begin; ind2++) {
@@ -787,7 +731,7 @@ double Mda::minimum() const
     if ((!NN) || (!ptr)) {
         return 0;
     }
-    return *std::min_element(ptr, ptr + NN);
+    return MLCompute::min(NN, ptr);
 }
 
 double Mda::maximum() const
@@ -797,7 +741,7 @@ double Mda::maximum() const
     if ((!NN) || (!ptr)) {
         return 0;
     }
-    return *std::max_element(ptr, ptr + NN);
+    return MLCompute::max(NN, ptr);
 }
 
 bool Mda::reshape(bigint N1b, bigint N2b, bigint N3b, bigint N4b, bigint N5b, bigint N6b)
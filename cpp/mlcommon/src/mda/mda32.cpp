@@ -27,6 +27,11 @@
 #define MDA_MAX_DIMS 6
 
 class MdaDataFloat : public MdaData<float> {
+public:
+    MdaDataFloat()
+        : MdaData<float>("mda32")
+    {
+    }
 };
 
 Mda32::Mda32(bigint N1, bigint N2, bigint N3, bigint N4, bigint N5, bigint N6)
@@ -51,6 +56,17 @@ void Mda32::operator=(const Mda32& other)
     d = other.d;
 }
 
+Mda32::Mda32(Mda32&& other)
+{
+    d = new MdaDataFloat;
+    d.swap(other.d);
+}
+
+void Mda32::operator=(Mda32&& other)
+{
+    d.swap(other.d);
+}
+
 Mda32::~Mda32()
 {
 }
@@ -58,9 +74,19 @@ Mda32::~Mda32()
 bool Mda32::allocate(bigint N1, bigint N2, bigint N3, bigint N4, bigint N5, bigint N6)
 {
 
+    //the old contents are about to be discarded, so if they are shared, start afresh rather than detaching (which would copy them)
+    if (d.constData()->ref.load() > 1)
+        d = new MdaDataFloat;
     return d->allocate((float)0, N1, N2, N3, N4, N5, N6);
 }
 
+bool Mda32::allocateUninitialized(bigint N1, bigint N2, bigint N3, bigint N4, bigint N5, bigint N6)
+{
+    if (d.constData()->ref.load() > 1)
+        d = new MdaDataFloat;
+    return d->allocateUninitialized(N1, N2, N3, N4, N5, N6);
+}
+
 bool Mda32::read(const QString& path)
 {
     return read(path.toLatin1().data());
@@ -102,8 +128,15 @@ bool Mda32::read(const char* path)
         fclose(input_file);
         return false;
     }
-    this->allocate(H.dims[0], H.dims[1], H.dims[2], H.dims[3], H.dims[4], H.dims[5]);
-    mda_read_float32(d->data(), &H, d->totalSize(), input_file);
+    if (!this->allocateUninitialized(H.dims[0], H.dims[1], H.dims[2], H.dims[3], H.dims[4], H.dims[5])) {
+        fclose(input_file);
+        return false;
+    }
+    bigint num_read = mda_read_float32(d->data(), &H, d->totalSize(), input_file);
+    if (num_read < d->totalSize()) {
+        qWarning() << "Unexpected end of mda file: " + QString(path) << num_read << d->totalSize();
+        std::fill(d->data() + qMax(num_read, (bigint)0), d->data() + d->totalSize(), 0);
+    }
     d->incrementBytesReadCounter(d->totalSize() * H.num_bytes_per_entry);
     fclose(input_file);
     return true;
@@ -374,6 +407,16 @@ const dtype32* Mda32::constDataPtr() const
     return d->constData();
 }
 
+MdaView<dtype32> Mda32::view()
+{
+    return MdaView<dtype32>(dataPtr(), N1(), N2(), N3(), N4(), N5(), N6());
+}
+
+MdaView<const dtype32> Mda32::constView() const
+{
+    return MdaView<const dtype32>(constDataPtr(), N1(), N2(), N3(), N4(), N5(), N6());
+}
+
 dtype32* Mda32::dataPtr(bigint i)
 {
     return d->data() + i;
@@ -401,132 +444,38 @@ dtype32* Mda32::dataPtr(bigint i1, bigint i2, bigint i3, bigint i4, bigint i5, b
 
 void Mda32::getChunk(Mda32& ret, bigint i, bigint size) const
 {
-    // A lot of bugs fixed on 5/31/16
-    bigint a_begin = i;
-    bigint x_begin = 0;
-    bigint a_end = i + size - 1;
-    //    bigint x_end = size - 1;  // unused?
-
-    if (a_begin < 0) {
-        x_begin += 0 - a_begin;
-        a_begin += 0 - a_begin;
-    }
-    if (a_end >= (bigint)d->totalSize()) {
-        //        x_end += (bigint)d->totalSize() - 1 - a_end; // unused?
-        a_end += (bigint)d->totalSize() - 1 - a_end;
-    }
-
-    ret.allocate(1, size);
-
-    const float* ptr1 = this->constDataPtr();
-    float* ptr2 = ret.dataPtr();
-
-    std::copy(ptr1 + a_begin, ptr1 + a_end + 1, ptr2 + x_begin);
+    if (!ret.allocateUninitialized(1, size))
+        return;
+    getChunk(ret.view(), i);
 }
 
 void Mda32::getChunk(Mda32& ret, bigint i1, bigint i2, bigint size1, bigint size2) const
 {
-    // A lot of bugs fixed on 5/31/16
-    bigint a1_begin = i1;
-    bigint x1_begin = 0;
-    bigint a1_end = i1 + size1 - 1;
-    bigint x1_end = size1 - 1;
-    if (a1_begin < 0) {
-        x1_begin += 0 - a1_begin;
-        a1_begin += 0 - a1_begin;
-    }
-    if (a1_end >= N1()) {
-        x1_end += N1() - 1 - a1_end;
-        a1_end += N1() - 1 - a1_end;
-    }
-
-    bigint a2_begin = i2;
-    bigint x2_begin = 0;
-    bigint a2_end = i2 + size2 - 1;
-    bigint x2_end = size2 - 1;
-    if (a2_begin < 0) {
-        x2_begin += 0 - a2_begin;
-        a2_begin += 0 - a2_begin;
-    }
-    if (a2_end >= N2()) {
-        x2_end += N2() - 1 - a2_end;
-        a2_end += N2() - 1 - a2_end;
-    }
-
-    ret.allocate(size1, size2);
-
-    const float* ptr1 = this->constDataPtr();
-    float* ptr2 = ret.dataPtr();
-
-    for (bigint ind2 = 0; ind2 <= a2_end - a2_begin; ind2++) {
-        bigint ii_out = (ind2 + x2_begin) * size1 + x1_begin; //bug fixed on 5/31/16 by jfm
-        bigint ii_in = (ind2 + a2_begin) * N1() + a1_begin; //bug fixed on 5/31/16 by jfm
-        for (bigint ind1 = 0; ind1 <= a1_end - a1_begin; ind1++) {
-            ptr2[ii_out] = ptr1[ii_in];
-            ii_in++;
-            ii_out++;
-        }
-    }
+    if (!ret.allocateUninitialized(size1, size2))
+        return;
+    getChunk(ret.view(), i1, i2);
 }
 
 void Mda32::getChunk(Mda32& ret, bigint i1, bigint i2, bigint i3, bigint size1, bigint size2, bigint size3) const
 {
-    // A lot of bugs fixed on 5/31/16
-    bigint a1_begin = i1;
-    bigint x1_begin = 0;
-    bigint a1_end = i1 + size1 - 1;
-    bigint x1_end = size1 - 1;
-    if (a1_begin < 0) {
-        x1_begin += 0 - a1_begin;
-        a1_begin += 0 - a1_begin;
-    }
-    if (a1_end >= N1()) {
-        x1_end += N1() - 1 - a1_end;
-        a1_end += N1() - 1 - a1_end;
-    }
-
-    bigint a2_begin = i2;
-    bigint x2_begin = 0;
-    bigint a2_end = i2 + size2 - 1;
-    bigint x2_end = size2 - 1;
-    if (a2_begin < 0) {
-        x2_begin += 0 - a2_begin;
-        a2_begin += 0 - a2_begin;
-    }
-    if (a2_end >= N2()) {
-        x2_end += N2() - 1 - a2_end;
-        a2_end += N2() - 1 - a2_end;
-    }
-
-    bigint a3_begin = i3;
-    bigint x3_begin = 0;
-    bigint a3_end = i3 + size3 - 1;
-    bigint x3_end = size3 - 1;
-    if (a3_begin < 0) {
-        x3_begin += 0 - a3_begin;
-        a3_begin += 0 - a3_begin;
-    }
-    if (a3_end >= N3()) {
-        x3_end += N3() - 1 - a3_end;
-        a3_end += N3() - 1 - a3_end;
-    }
+    if (!ret.allocateUninitialized(size1, size2, size3))
+        return;
+    getChunk(ret.view(), i1, i2, i3);
+}
 
-    ret.allocate(size1, size2, size3);
+void Mda32::getChunk(const MdaView<dtype32>& ret, bigint i) const
+{
+    mda_copy_chunk(ret.data(), ret.totalSize(), (bigint)1, (bigint)1, d->constData(), d->totalSize(), (bigint)1, (bigint)1, i, (bigint)0, (bigint)0);
+}
 
-    const float* ptr1 = this->constDataPtr();
-    float* ptr2 = ret.dataPtr();
+void Mda32::getChunk(const MdaView<dtype32>& ret, bigint i1, bigint i2) const
+{
+    mda_copy_chunk(ret.data(), ret.N1(), ret.N2(), (bigint)1, d->constData(), N1(), N2(), (bigint)1, i1, i2, (bigint)0);
+}
 
-    for (bigint ind3 = 0; ind3 <= a3_end - a3_begin; ind3++) {
-        for (bigint ind2 = 0; ind2 <= a2_end - a2_begin; ind2++) {
-            bigint ii_out = x1_begin + (ind2 + x2_begin) * size1 + (ind3 + x3_begin) * size1 * size2; //bug fixed on 5/31/16 by jfm
-            bigint ii_in = a1_begin + (ind2 + a2_begin) * N1() + (ind3 + a3_begin) * N1() * N2(); //bug fixed on 5/31/16 by jfm
-            for (bigint ind1 = 0; ind1 <= a1_end - a1_begin; ind1++) {
-                ptr2[ii_out] = ptr1[ii_in];
-                ii_in++;
-                ii_out++;
-            }
-        }
-    }
+void Mda32::getChunk(const MdaView<dtype32>& ret, bigint i1, bigint i2, bigint i3) const
+{
+    mda_copy_chunk(ret.data(), ret.N1(), ret.N2(), ret.N3(), d->constData(), N1(), N2(), N3(), i1, i2, i3);
 }
 
 void Mda32::setChunk(Mda32& X, bigint i)
@@ -548,7 +497,7 @@ void Mda32::setChunk(Mda32& X, bigint i)
     }
 
     float* ptr1 = this->dataPtr();
-    float* ptr2 = X.dataPtr();
+    const float* ptr2 = X.constDataPtr();
 
     bigint ii = 0;
     for (bigint a = a_begin; a <= a_end; a++) {
@@ -589,7 +538,7 @@ void Mda32::setChunk(Mda32& X, bigint i1, bigint i2)
     }
 
     dtype32* ptr1 = this->dataPtr();
-    dtype32* ptr2 = X.dataPtr();
+    const dtype32* ptr2 = X.constDataPtr();
 
     for (bigint ind2 = 0; ind2 <= a2_end - a2_begin; ind2++) {
         bigint ii_out = (ind2 + x2_begin) * size1;
@@ -648,7 +597,7 @@ void Mda32::setChunk(Mda32& X, bigint i1, bigint i2, bigint i3)
     }
 
     dtype32* ptr1 = this->dataPtr();
-    dtype32* ptr2 = X.dataPtr();
+    const dtype32* ptr2 = X.constDataPtr();
 
     for (bigint ind3 = 0; ind3 <= a3_end - a3_begin; ind3++) {
         for (bigint ind2 = 0; ind2 <= a2_end - a2_begin; ind2++) {
@@ -670,7 +619,7 @@ dtype32 Mda32::minimum() const
     if ((!NN) || (!ptr)) {
         return 0;
     }
-    return *std::min_element(ptr, ptr + NN);
+    return (dtype32)MLCompute::min(NN, ptr);
 }
 
 dtype32 Mda32::maximum() const
@@ -680,7 +629,7 @@ dtype32 Mda32::maximum() const
     if ((!NN) || (!ptr)) {
         return 0;
     }
-    return *std::max_element(ptr, ptr + NN);
+    return (dtype32)MLCompute::max(NN, ptr);
 }
 
 bool Mda32::reshape(bigint N1b, bigint N2b, bigint N3b, bigint N4b, bigint N5b, bigint N6b)
@@ -0,0 +1,353 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mdabufferpool.h"
+#include "mdamemorybudget.h"
+#include <icounter.h>
+#include <objectregistry.h>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+#include <QList>
+#include <algorithm>
+#include <atomic>
+#include <stdlib.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#define DEFAULT_THREAD_CACHE_SIZE (4 * 1024 * 1024)
+#define DEFAULT_SHARED_CACHE_SIZE (64 * 1024 * 1024)
+//hits are added to the counter in bulk, since a counter update emits a signal
+#define POOL_HITS_FLUSH_INTERVAL 1024
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static std::atomic<bigint> s_default_thread_cache_size(DEFAULT_THREAD_CACHE_SIZE);
+static std::atomic<bigint> s_shared_cache_size(DEFAULT_SHARED_CACHE_SIZE);
+static std::atomic<bool> s_use_huge_pages(false);
+
+static IIntCounter* pool_counter(const char* name)
+{
+    ICounterManager* manager = ObjectRegistry::getObject<ICounterManager>();
+    if (!manager)
+        return 0;
+    return static_cast<IIntCounter*>(manager->counter(name));
+}
+
+static void add_to_counter(const char* name, bigint val)
+{
+    if (!val)
+        return;
+    IIntCounter* counter = pool_counter(name);
+    if (counter)
+        counter->add(val);
+}
+
+static bigint size_class(bigint num_bytes)
+{
+    //round up to a multiple of a quarter of the enclosing power of two
+    if (num_bytes <= MDA_BUFFER_ALIGNMENT)
+        return MDA_BUFFER_ALIGNMENT;
+    bigint pow2 = MDA_BUFFER_ALIGNMENT;
+    while (pow2 < num_bytes)
+        pow2 *= 2;
+    bigint step = pow2 / 8;
+    return ((num_bytes + step - 1) / step) * step;
+}
+
+static void* system_allocate(bigint num_bytes)
+{
+    void* ret = 0;
+#ifdef __WIN32
+    ret = _aligned_malloc(num_bytes, MDA_BUFFER_ALIGNMENT);
+#else
+    bool huge = false;
+#ifdef MADV_HUGEPAGE
+    huge = ((s_use_huge_pages) && (num_bytes >= HUGE_PAGE_SIZE));
+#endif
+    if (posix_memalign(&ret, huge ? HUGE_PAGE_SIZE : MDA_BUFFER_ALIGNMENT, num_bytes) != 0)
+        ret = 0;
+#ifdef MADV_HUGEPAGE
+    //only whole huge pages can be backed, and failure is harmless (the kernel may not support it)
+    if ((ret) && (huge))
+        madvise(ret, (num_bytes / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+#endif
+#endif
+    if (ret)
+        add_to_counter("allocated_bytes", num_bytes);
+    return ret;
+}
+
+static void system_free(void* ptr, bigint num_bytes)
+{
+#ifdef __WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+    add_to_counter("freed_bytes", num_bytes);
+}
+
+class MdaBufferPoolThreadCache {
+public:
+    MdaBufferPoolThreadCache()
+    {
+        m_max_bytes = s_default_thread_cache_size;
+    }
+    ~MdaBufferPoolThreadCache()
+    {
+        //the counters may already be gone when the thread exits at shutdown, so free quietly
+        QHash<bigint, QVector<void*> >::iterator it;
+        for (it = m_free_buffers.begin(); it != m_free_buffers.end(); ++it) {
+            foreach (void* ptr, it.value()) {
+#ifdef __WIN32
+                _aligned_free(ptr);
+#else
+                free(ptr);
+#endif
+            }
+        }
+    }
+    void clear()
+    {
+        QHash<bigint, QVector<void*> >::iterator it;
+        for (it = m_free_buffers.begin(); it != m_free_buffers.end(); ++it) {
+            foreach (void* ptr, it.value()) {
+                system_free(ptr, it.key());
+            }
+        }
+        m_free_buffers.clear();
+        m_cached_bytes = 0;
+    }
+    void flush_hits()
+    {
+        add_to_counter("mda_pool_hits", m_hits);
+        m_hits = 0;
+    }
+
+    QHash<bigint, QVector<void*> > m_free_buffers; //by size class
+    bigint m_cached_bytes = 0;
+    bigint m_max_bytes = 0;
+    bigint m_hits = 0; //not yet added to the counter
+};
+
+static MdaBufferPoolThreadCache& thread_cache()
+{
+    static thread_local MdaBufferPoolThreadCache cache;
+    return cache;
+}
+
+//buffers that do not fit in the cache of the releasing thread, available to all threads. This is what lets a thread that only allocates (such as a reader feeding another thread) reuse the buffers freed by a thread that only releases
+class MdaBufferPoolSharedCache {
+public:
+    void* take(bigint class_size)
+    {
+        QMutexLocker locker(&m_mutex);
+        QHash<bigint, QVector<void*> >::iterator it = m_free_buffers.find(class_size);
+        if ((it == m_free_buffers.end()) || (it.value().isEmpty()))
+            return 0;
+        void* ret = it.value().last();
+        it.value().removeLast();
+        m_cached_bytes -= class_size;
+        return ret;
+    }
+    bool put(void* ptr, bigint class_size)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_cached_bytes + class_size > s_shared_cache_size)
+            return false;
+        m_free_buffers[class_size].append(ptr);
+        m_cached_bytes += class_size;
+        return true;
+    }
+    void clear(bigint max_bytes)
+    {
+        //free buffers, largest first, until at most max_bytes are left
+        QMutexLocker locker(&m_mutex);
+        QList<bigint> sizes = m_free_buffers.keys();
+        std::sort(sizes.begin(), sizes.end());
+        for (int i = sizes.count() - 1; (i >= 0) && (m_cached_bytes > max_bytes); i--) {
+            QVector<void*>& buffers = m_free_buffers[sizes[i]];
+            while ((!buffers.isEmpty()) && (m_cached_bytes > max_bytes)) {
+                system_free(buffers.last(), sizes[i]);
+                buffers.removeLast();
+                m_cached_bytes -= sizes[i];
+            }
+        }
+    }
+    bigint cachedBytes()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_cached_bytes;
+    }
+
+private:
+    QMutex m_mutex;
+    QHash<bigint, QVector<void*> > m_free_buffers; //by size class
+    bigint m_cached_bytes = 0;
+};
+
+static MdaBufferPoolSharedCache& shared_cache()
+{
+    static MdaBufferPoolSharedCache cache;
+    return cache;
+}
+
+void* MdaBufferPool::allocate(bigint num_bytes)
+{
+    if (num_bytes <= 0)
+        return 0;
+    bigint class_size = size_class(num_bytes);
+    MdaBufferPoolThreadCache& cache = thread_cache();
+    QHash<bigint, QVector<void*> >::iterator it = cache.m_free_buffers.find(class_size);
+    if ((it != cache.m_free_buffers.end()) && (!it.value().isEmpty())) {
+        void* ret = it.value().last();
+        it.value().removeLast();
+        cache.m_cached_bytes -= class_size;
+        cache.m_hits++;
+        if (cache.m_hits >= POOL_HITS_FLUSH_INTERVAL)
+            cache.flush_hits();
+        return ret;
+    }
+    void* ret = shared_cache().take(class_size);
+    if (ret) {
+        cache.m_hits++;
+        if (cache.m_hits >= POOL_HITS_FLUSH_INTERVAL)
+            cache.flush_hits();
+        return ret;
+    }
+    add_to_counter("mda_pool_misses", 1);
+    ret = system_allocate(class_size);
+    if (!ret) {
+        //the cached buffers may be what is standing in the way
+        cache.clear();
+        shared_cache().clear(0);
+        ret = system_allocate(class_size);
+    }
+    return ret;
+}
+
+void MdaBufferPool::release(void* ptr, bigint num_bytes)
+{
+    if (!ptr)
+        return;
+    bigint class_size = size_class(num_bytes);
+    MdaBufferPoolThreadCache& cache = thread_cache();
+    if (cache.m_cached_bytes + class_size > cache.m_max_bytes) {
+        if (!shared_cache().put(ptr, class_size))
+            system_free(ptr, class_size);
+        return;
+    }
+    cache.m_free_buffers[class_size].append(ptr);
+    cache.m_cached_bytes += class_size;
+}
+
+void MdaBufferPool::setThreadCacheSize(bigint num_bytes)
+{
+    MdaBufferPoolThreadCache& cache = thread_cache();
+    cache.m_max_bytes = num_bytes;
+    if (cache.m_cached_bytes > num_bytes)
+        cache.clear();
+}
+
+bigint MdaBufferPool::threadCacheSize()
+{
+    return thread_cache().m_max_bytes;
+}
+
+void MdaBufferPool::setDefaultThreadCacheSize(bigint num_bytes)
+{
+    s_default_thread_cache_size = num_bytes;
+}
+
+void MdaBufferPool::clearThreadCache()
+{
+    thread_cache().clear();
+}
+
+void MdaBufferPool::setSharedCacheSize(bigint num_bytes)
+{
+    s_shared_cache_size = num_bytes;
+    shared_cache().clear(num_bytes);
+}
+
+bigint MdaBufferPool::sharedCacheSize()
+{
+    return s_shared_cache_size;
+}
+
+void MdaBufferPool::clearSharedCache()
+{
+    shared_cache().clear(0);
+}
+
+bigint MdaBufferPool::cachedBytes()
+{
+    return thread_cache().m_cached_bytes + shared_cache().cachedBytes();
+}
+
+void MdaBufferPool::setUseHugePages(bool val)
+{
+    s_use_huge_pages = val;
+}
+
+bool MdaBufferPool::useHugePages()
+{
+    return s_use_huge_pages;
+}
+
+MdaPooledBuffer::MdaPooledBuffer(bigint num_bytes, const char* budget_subsystem)
+{
+    m_data = 0;
+    m_size = 0;
+    m_budget_subsystem = budget_subsystem;
+    resize(num_bytes);
+}
+
+MdaPooledBuffer::~MdaPooledBuffer()
+{
+    free_data();
+}
+
+bool MdaPooledBuffer::resize(bigint num_bytes)
+{
+    if ((m_data) && (num_bytes <= m_size))
+        return true;
+    free_data();
+    if (num_bytes <= 0)
+        return true;
+    if ((m_budget_subsystem) && (!MdaMemoryBudget::acquire(num_bytes, m_budget_subsystem)))
+        return false;
+    m_data = (char*)MdaBufferPool::allocate(num_bytes);
+    if (!m_data) {
+        if (m_budget_subsystem)
+            MdaMemoryBudget::release(num_bytes, m_budget_subsystem);
+        return false;
+    }
+    m_size = num_bytes;
+    return true;
+}
+
+void MdaPooledBuffer::free_data()
+{
+    if (!m_data)
+        return;
+    MdaBufferPool::release(m_data, m_size);
+    if (m_budget_subsystem)
+        MdaMemoryBudget::release(m_size, m_budget_subsystem);
+    m_data = 0;
+    m_size = 0;
+}
@@ -17,7 +17,17 @@
 #include "usagetracking.h"
 #include <vector>
 #include <cstring>
+#include <algorithm>
 #include <inttypes.h>
+#include <chrono>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MDAIO_USE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+//number of entries converted per pass when reading or writing through a temporary buffer
+#define MDAIO_CONVERT_BLOCK_SIZE 8192
 
 //can be replaced by std::is_same when C++11 is enabled
 template <class T, class U>
@@ -201,6 +211,314 @@ bigint mda_write_header(struct MDAIO_HEADER* X, FILE* output_file)
     return 1;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Conversion kernels
+//
+// mda_convert_kernel<SourceType,TargetType>(dst,src,n) converts n entries. The
+// generic version is a plain element-wise cast. The hot pairs (int16/uint16 to
+// float32/float64, float32<->float64 and float32 to int16) have SSE2 and AVX2
+// versions, selected at runtime according to what the cpu supports. Conversion
+// to int16 saturates at the limits of the type (NaN maps to -32768).
+
+static inline int16_t saturate_int16(float val)
+{
+    if (!(val >= -32768.0f))
+        return -32768;
+    if (val > 32767.0f)
+        return 32767;
+    return (int16_t)val;
+}
+
+static inline int16_t saturate_int16(double val)
+{
+    if (!(val >= -32768.0))
+        return -32768;
+    if (val > 32767.0)
+        return 32767;
+    return (int16_t)val;
+}
+
+static void convert_int16_float32_scalar(float* dst, const int16_t* src, bigint n)
+{
+    for (bigint i = 0; i < n; i++)
+        dst[i] = src[i];
+}
+
+static void convert_int16_float64_scalar(double* dst, const int16_t* src, bigint n)
+{
+    for (bigint i = 0; i < n; i++)
+        dst[i] = src[i];
+}
+
+static void convert_uint16_float32_scalar(float* dst, const uint16_t* src, bigint n)
+{
+    for (bigint i = 0; i < n; i++)
+        dst[i] = src[i];
+}
+
+static void convert_float32_float64_scalar(double* dst, const float* src, bigint n)
+{
+    for (bigint i = 0; i < n; i++)
+        dst[i] = src[i];
+}
+
+static void convert_float64_float32_scalar(float* dst, const double* src, bigint n)
+{
+    for (bigint i = 0; i < n; i++)
+        dst[i] = (float)src[i];
+}
+
+static void convert_float32_int16_scalar(int16_t* dst, const float* src, bigint n)
+{
+    for (bigint i = 0; i < n; i++)
+        dst[i] = saturate_int16(src[i]);
+}
+
+#ifdef MDAIO_USE_X86_KERNELS
+
+__attribute__((target("sse2"))) static void convert_int16_float32_sse2(float* dst, const int16_t* src, bigint n)
+{
+    bigint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        //sign-extend by placing each int16 in the upper half of an int32 and shifting back down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(lo));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(hi));
+    }
+    convert_int16_float32_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void convert_int16_float64_sse2(double* dst, const int16_t* src, bigint n)
+{
+    bigint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_pd(dst + i, _mm_cvtepi32_pd(lo));
+        _mm_storeu_pd(dst + i + 2, _mm_cvtepi32_pd(_mm_unpackhi_epi64(lo, lo)));
+        _mm_storeu_pd(dst + i + 4, _mm_cvtepi32_pd(hi));
+        _mm_storeu_pd(dst + i + 6, _mm_cvtepi32_pd(_mm_unpackhi_epi64(hi, hi)));
+    }
+    convert_int16_float64_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void convert_uint16_float32_sse2(float* dst, const uint16_t* src, bigint n)
+{
+    bigint i = 0;
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)));
+    }
+    convert_uint16_float32_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void convert_float32_float64_sse2(double* dst, const float* src, bigint n)
+{
+    bigint i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(src + i);
+        _mm_storeu_pd(dst + i, _mm_cvtps_pd(x));
+        _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+    }
+    convert_float32_float64_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void convert_float64_float32_sse2(float* dst, const double* src, bigint n)
+{
+    bigint i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+        _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+    }
+    convert_float64_float32_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void convert_float32_int16_sse2(int16_t* dst, const float* src, bigint n)
+{
+    bigint i = 0;
+    //clamp first, since cvttps returns INT_MIN for values out of the int32 range. max_ps maps NaN to the lower limit
+    const __m128 lower = _mm_set1_ps(-32768.0f);
+    const __m128 upper = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lower), upper);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), lower), upper);
+        __m128i x = _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+        _mm_storeu_si128((__m128i*)(dst + i), x);
+    }
+    convert_float32_int16_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void convert_int16_float32_avx2(float* dst, const int16_t* src, bigint n)
+{
+    bigint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(x));
+    }
+    convert_int16_float32_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void convert_int16_float64_avx2(double* dst, const int16_t* src, bigint n)
+{
+    bigint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_pd(dst + i, _mm256_cvtepi32_pd(_mm256_castsi256_si128(x)));
+        _mm256_storeu_pd(dst + i + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1)));
+    }
+    convert_int16_float64_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void convert_uint16_float32_avx2(float* dst, const uint16_t* src, bigint n)
+{
+    bigint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(x));
+    }
+    convert_uint16_float32_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void convert_float32_float64_avx2(double* dst, const float* src, bigint n)
+{
+    bigint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(_mm_loadu_ps(src + i)));
+        _mm256_storeu_pd(dst + i + 4, _mm256_cvtps_pd(_mm_loadu_ps(src + i + 4)));
+    }
+    convert_float32_float64_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void convert_float64_float32_avx2(float* dst, const double* src, bigint n)
+{
+    bigint i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(_mm256_loadu_pd(src + i)));
+        _mm_storeu_ps(dst + i + 4, _mm256_cvtpd_ps(_mm256_loadu_pd(src + i + 4)));
+    }
+    convert_float64_float32_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void convert_float32_int16_avx2(int16_t* dst, const float* src, bigint n)
+{
+    bigint i = 0;
+    const __m256 lower = _mm256_set1_ps(-32768.0f);
+    const __m256 upper = _mm256_set1_ps(32767.0f);
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lower), upper);
+        __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i + 8), lower), upper);
+        //packs works within 128-bit lanes, so restore the order of the 64-bit blocks afterwards
+        __m256i x = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+        x = _mm256_permute4x64_epi64(x, 0xD8);
+        _mm256_storeu_si256((__m256i*)(dst + i), x);
+    }
+    convert_float32_int16_scalar(dst + i, src + i, n - i);
+}
+
+#endif
+
+struct MdaConvertKernels {
+    void (*int16_float32)(float*, const int16_t*, bigint);
+    void (*int16_float64)(double*, const int16_t*, bigint);
+    void (*uint16_float32)(float*, const uint16_t*, bigint);
+    void (*float32_float64)(double*, const float*, bigint);
+    void (*float64_float32)(float*, const double*, bigint);
+    void (*float32_int16)(int16_t*, const float*, bigint);
+    const char* name;
+
+    MdaConvertKernels()
+    {
+        name = "scalar";
+        int16_float32 = convert_int16_float32_scalar;
+        int16_float64 = convert_int16_float64_scalar;
+        uint16_float32 = convert_uint16_float32_scalar;
+        float32_float64 = convert_float32_float64_scalar;
+        float64_float32 = convert_float64_float32_scalar;
+        float32_int16 = convert_float32_int16_scalar;
+#ifdef MDAIO_USE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            int16_float32 = convert_int16_float32_avx2;
+            int16_float64 = convert_int16_float64_avx2;
+            uint16_float32 = convert_uint16_float32_avx2;
+            float32_float64 = convert_float32_float64_avx2;
+            float64_float32 = convert_float64_float32_avx2;
+            float32_int16 = convert_float32_int16_avx2;
+            name = "avx2";
+        }
+        else if (__builtin_cpu_supports("sse2")) {
+            int16_float32 = convert_int16_float32_sse2;
+            int16_float64 = convert_int16_float64_sse2;
+            uint16_float32 = convert_uint16_float32_sse2;
+            float32_float64 = convert_float32_float64_sse2;
+            float64_float32 = convert_float64_float32_sse2;
+            float32_int16 = convert_float32_int16_sse2;
+            name = "sse2";
+        }
+#endif
+    }
+};
+
+static const MdaConvertKernels& mda_convert_kernels()
+{
+    static MdaConvertKernels kernels; //selected once, on first use
+    return kernels;
+}
+
+template <typename SourceType, typename TargetType>
+struct MdaConvertKernel {
+    static void run(TargetType* dst, const SourceType* src, bigint n)
+    {
+        std::copy(src, src + n, dst);
+    }
+};
+template <>
+struct MdaConvertKernel<int16_t, float> {
+    static void run(float* dst, const int16_t* src, bigint n) { mda_convert_kernels().int16_float32(dst, src, n); }
+};
+template <>
+struct MdaConvertKernel<int16_t, double> {
+    static void run(double* dst, const int16_t* src, bigint n) { mda_convert_kernels().int16_float64(dst, src, n); }
+};
+template <>
+struct MdaConvertKernel<uint16_t, float> {
+    static void run(float* dst, const uint16_t* src, bigint n) { mda_convert_kernels().uint16_float32(dst, src, n); }
+};
+template <>
+struct MdaConvertKernel<float, double> {
+    static void run(double* dst, const float* src, bigint n) { mda_convert_kernels().float32_float64(dst, src, n); }
+};
+template <>
+struct MdaConvertKernel<double, float> {
+    static void run(float* dst, const double* src, bigint n) { mda_convert_kernels().float64_float32(dst, src, n); }
+};
+template <>
+struct MdaConvertKernel<float, int16_t> {
+    static void run(int16_t* dst, const float* src, bigint n) { mda_convert_kernels().float32_int16(dst, src, n); }
+};
+template <>
+struct MdaConvertKernel<double, int16_t> {
+    static void run(int16_t* dst, const double* src, bigint n)
+    {
+        for (bigint i = 0; i < n; i++)
+            dst[i] = saturate_int16(src[i]);
+    }
+};
+
+template <typename SourceType, typename TargetType>
+void mda_convert_kernel(TargetType* dst, const SourceType* src, bigint n)
+{
+    MdaConvertKernel<SourceType, TargetType>::run(dst, src, n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 template <typename SourceType, typename TargetType>
 bigint mdaReadData_impl(TargetType* data, const bigint size, FILE* inputFile)
 {
@@ -208,13 +526,69 @@ bigint mdaReadData_impl(TargetType* data, const bigint size, FILE* inputFile)
         return jfread(data, sizeof(SourceType), size, inputFile);
     }
     else {
-        std::vector<SourceType> tmp(size);
-        const bigint ret = jfread(&tmp[0], sizeof(SourceType), size, inputFile);
-        std::copy(tmp.begin(), tmp.end(), data);
+        SourceType tmp[MDAIO_CONVERT_BLOCK_SIZE];
+        bigint ret = 0;
+        while (ret < size) {
+            const bigint num = std::min((bigint)MDAIO_CONVERT_BLOCK_SIZE, size - ret);
+            const bigint num_read = jfread(tmp, sizeof(SourceType), num, inputFile);
+            mda_convert_kernel(data + ret, tmp, num_read);
+            ret += num_read;
+            if (num_read != num)
+                break;
+        }
         return ret;
     }
 }
 
+template <typename SourceType, typename TargetType>
+bigint mdaPreadData_impl(TargetType* data, const bigint size, int fd, bigint offset)
+{
+    if (is_same<TargetType, SourceType>::value) {
+        return jpread(data, sizeof(SourceType), size, fd, offset);
+    }
+    else {
+        SourceType tmp[MDAIO_CONVERT_BLOCK_SIZE];
+        bigint ret = 0;
+        while (ret < size) {
+            const bigint num = std::min((bigint)MDAIO_CONVERT_BLOCK_SIZE, size - ret);
+            const bigint num_read = jpread(tmp, sizeof(SourceType), num, fd, offset + ret * sizeof(SourceType));
+            mda_convert_kernel(data + ret, tmp, num_read);
+            ret += num_read;
+            if (num_read != num)
+                break;
+        }
+        return ret;
+    }
+}
+
+template <typename Type>
+bigint mdaPreadData(Type* data, const struct MDAIO_HEADER* header, const bigint size, int fd, bigint offset)
+{
+    if (header->data_type == MDAIO_TYPE_BYTE) {
+        return mdaPreadData_impl<unsigned char>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_FLOAT32) {
+        return mdaPreadData_impl<float>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_INT16) {
+        return mdaPreadData_impl<int16_t>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_INT32) {
+        return mdaPreadData_impl<int32_t>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_UINT16) {
+        return mdaPreadData_impl<uint16_t>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_FLOAT64) {
+        return mdaPreadData_impl<double>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_UINT32) {
+        return mdaPreadData_impl<uint32_t>(data, size, fd, offset);
+    }
+    else
+        return 0;
+}
+
 template <typename Type>
 bigint mdaReadData(Type* data, const struct MDAIO_HEADER* header, const bigint size, FILE* inputFile)
 {
@@ -243,6 +617,56 @@ bigint mdaReadData(Type* data, const struct MDAIO_HEADER* header, const bigint s
         return 0;
 }
 
+template <typename SourceType, typename TargetType>
+bigint mdaConvertData_impl(TargetType* data, const bigint size, const void* inputBuffer)
+{
+    const SourceType* src = (const SourceType*)inputBuffer;
+    if (is_same<TargetType, SourceType>::value) {
+        std::memcpy(data, inputBuffer, sizeof(SourceType) * size);
+    }
+    else if ((uintptr_t)inputBuffer % alignof(SourceType) != 0) {
+        //the data of a mapped file starts right after the header, which need not be a multiple of the entry size, so the entries are copied to an aligned buffer before they are read
+        SourceType tmp[MDAIO_CONVERT_BLOCK_SIZE];
+        for (bigint ret = 0; ret < size; ret += MDAIO_CONVERT_BLOCK_SIZE) {
+            const bigint num = std::min((bigint)MDAIO_CONVERT_BLOCK_SIZE, size - ret);
+            std::memcpy(tmp, (const char*)inputBuffer + ret * sizeof(SourceType), num * sizeof(SourceType));
+            mda_convert_kernel(data + ret, tmp, num);
+        }
+    }
+    else {
+        mda_convert_kernel(data, src, size);
+    }
+    return size;
+}
+
+template <typename Type>
+bigint mdaConvertData(Type* data, const struct MDAIO_HEADER* header, const bigint size, const void* inputBuffer)
+{
+    if (header->data_type == MDAIO_TYPE_BYTE) {
+        return mdaConvertData_impl<unsigned char>(data, size, inputBuffer);
+    }
+    else if (header->data_type == MDAIO_TYPE_FLOAT32) {
+        return mdaConvertData_impl<float>(data, size, inputBuffer);
+    }
+    else if (header->data_type == MDAIO_TYPE_INT16) {
+        return mdaConvertData_impl<int16_t>(data, size, inputBuffer);
+    }
+    else if (header->data_type == MDAIO_TYPE_INT32) {
+        return mdaConvertData_impl<int32_t>(data, size, inputBuffer);
+    }
+    else if (header->data_type == MDAIO_TYPE_UINT16) {
+        return mdaConvertData_impl<uint16_t>(data, size, inputBuffer);
+    }
+    else if (header->data_type == MDAIO_TYPE_FLOAT64) {
+        return mdaConvertData_impl<double>(data, size, inputBuffer);
+    }
+    else if (header->data_type == MDAIO_TYPE_UINT32) {
+        return mdaConvertData_impl<uint32_t>(data, size, inputBuffer);
+    }
+    else
+        return 0;
+}
+
 template <typename TargetType, typename DataType>
 bigint mdaWriteData_impl(DataType* data, const bigint size, FILE* outputFile)
 {
@@ -250,9 +674,17 @@ bigint mdaWriteData_impl(DataType* data, const bigint size, FILE* outputFile)
         return fwrite(data, sizeof(DataType), size, outputFile);
     }
     else {
-        std::vector<TargetType> tmp(size);
-        std::copy(data, data + size, tmp.begin());
-        return fwrite(&tmp[0], sizeof(TargetType), size, outputFile);
+        TargetType tmp[MDAIO_CONVERT_BLOCK_SIZE];
+        bigint ret = 0;
+        while (ret < size) {
+            const bigint num = std::min((bigint)MDAIO_CONVERT_BLOCK_SIZE, size - ret);
+            mda_convert_kernel(tmp, data + ret, num);
+            const bigint num_written = fwrite(tmp, sizeof(TargetType), num, outputFile);
+            ret += num_written;
+            if (num_written != num)
+                break;
+        }
+        return ret;
     }
 }
 
@@ -284,6 +716,55 @@ bigint mdaWriteData(DataType* data, const bigint size, const struct MDAIO_HEADER
         return 0;
 }
 
+template <typename TargetType, typename DataType>
+bigint mdaPwriteData_impl(const DataType* data, const bigint size, int fd, bigint offset)
+{
+    if (is_same<DataType, TargetType>::value) {
+        return jpwrite(data, sizeof(DataType), size, fd, offset);
+    }
+    else {
+        TargetType tmp[MDAIO_CONVERT_BLOCK_SIZE];
+        bigint ret = 0;
+        while (ret < size) {
+            const bigint num = std::min((bigint)MDAIO_CONVERT_BLOCK_SIZE, size - ret);
+            mda_convert_kernel(tmp, data + ret, num);
+            const bigint num_written = jpwrite(tmp, sizeof(TargetType), num, fd, offset + ret * sizeof(TargetType));
+            ret += num_written;
+            if (num_written != num)
+                break;
+        }
+        return ret;
+    }
+}
+
+template <typename DataType>
+bigint mdaPwriteData(const DataType* data, const bigint size, const struct MDAIO_HEADER* header, int fd, bigint offset)
+{
+    if (header->data_type == MDAIO_TYPE_BYTE) {
+        return mdaPwriteData_impl<unsigned char>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_FLOAT32) {
+        return mdaPwriteData_impl<float>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_INT16) {
+        return mdaPwriteData_impl<int16_t>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_INT32) {
+        return mdaPwriteData_impl<int32_t>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_UINT16) {
+        return mdaPwriteData_impl<uint16_t>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_FLOAT64) {
+        return mdaPwriteData_impl<double>(data, size, fd, offset);
+    }
+    else if (header->data_type == MDAIO_TYPE_UINT32) {
+        return mdaPwriteData_impl<uint32_t>(data, size, fd, offset);
+    }
+    else
+        return 0;
+}
+
 bigint mda_read_byte(unsigned char* data, struct MDAIO_HEADER* H, bigint n, FILE* input_file)
 {
     return mdaReadData(data, H, n, input_file);
@@ -354,6 +835,177 @@ bigint mda_write_uint32(uint32_t* data, struct MDAIO_HEADER* H, bigint n, FILE*
     return mdaWriteData(data, n, H, output_file);
 }
 
+bigint mda_convert_byte(unsigned char* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer)
+{
+    return mdaConvertData(data, H, n, input_buffer);
+}
+
+bigint mda_convert_float32(float* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer)
+{
+    return mdaConvertData(data, H, n, input_buffer);
+}
+
+bigint mda_convert_int16(int16_t* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer)
+{
+    return mdaConvertData(data, H, n, input_buffer);
+}
+
+bigint mda_convert_int32(int32_t* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer)
+{
+    return mdaConvertData(data, H, n, input_buffer);
+}
+
+bigint mda_convert_uint16(uint16_t* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer)
+{
+    return mdaConvertData(data, H, n, input_buffer);
+}
+
+bigint mda_convert_float64(double* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer)
+{
+    return mdaConvertData(data, H, n, input_buffer);
+}
+
+bigint mda_convert_uint32(uint32_t* data, struct MDAIO_HEADER* H, bigint n, const void* input_buffer)
+{
+    return mdaConvertData(data, H, n, input_buffer);
+}
+
+bigint mda_read_data(void* data, int data_type, struct MDAIO_HEADER* H, bigint n, FILE* input_file)
+{
+    if (data_type == MDAIO_TYPE_BYTE)
+        return mda_read_byte((unsigned char*)data, H, n, input_file);
+    else if (data_type == MDAIO_TYPE_FLOAT32)
+        return mda_read_float32((float*)data, H, n, input_file);
+    else if (data_type == MDAIO_TYPE_INT16)
+        return mda_read_int16((int16_t*)data, H, n, input_file);
+    else if (data_type == MDAIO_TYPE_INT32)
+        return mda_read_int32((int32_t*)data, H, n, input_file);
+    else if (data_type == MDAIO_TYPE_UINT16)
+        return mda_read_uint16((uint16_t*)data, H, n, input_file);
+    else if (data_type == MDAIO_TYPE_FLOAT64)
+        return mda_read_float64((double*)data, H, n, input_file);
+    else if (data_type == MDAIO_TYPE_UINT32)
+        return mda_read_uint32((uint32_t*)data, H, n, input_file);
+    else
+        return 0;
+}
+
+bigint mda_pread_data(void* data, int data_type, struct MDAIO_HEADER* H, bigint n, int fd, bigint offset)
+{
+    if (data_type == MDAIO_TYPE_BYTE)
+        return mdaPreadData((unsigned char*)data, H, n, fd, offset);
+    else if (data_type == MDAIO_TYPE_FLOAT32)
+        return mdaPreadData((float*)data, H, n, fd, offset);
+    else if (data_type == MDAIO_TYPE_INT16)
+        return mdaPreadData((int16_t*)data, H, n, fd, offset);
+    else if (data_type == MDAIO_TYPE_INT32)
+        return mdaPreadData((int32_t*)data, H, n, fd, offset);
+    else if (data_type == MDAIO_TYPE_UINT16)
+        return mdaPreadData((uint16_t*)data, H, n, fd, offset);
+    else if (data_type == MDAIO_TYPE_FLOAT64)
+        return mdaPreadData((double*)data, H, n, fd, offset);
+    else if (data_type == MDAIO_TYPE_UINT32)
+        return mdaPreadData((uint32_t*)data, H, n, fd, offset);
+    else
+        return 0;
+}
+
+bigint mda_pwrite_data(const void* data, int data_type, struct MDAIO_HEADER* H, bigint n, int fd, bigint offset)
+{
+    if (data_type == MDAIO_TYPE_BYTE)
+        return mdaPwriteData((const unsigned char*)data, n, H, fd, offset);
+    else if (data_type == MDAIO_TYPE_FLOAT32)
+        return mdaPwriteData((const float*)data, n, H, fd, offset);
+    else if (data_type == MDAIO_TYPE_INT16)
+        return mdaPwriteData((const int16_t*)data, n, H, fd, offset);
+    else if (data_type == MDAIO_TYPE_INT32)
+        return mdaPwriteData((const int32_t*)data, n, H, fd, offset);
+    else if (data_type == MDAIO_TYPE_UINT16)
+        return mdaPwriteData((const uint16_t*)data, n, H, fd, offset);
+    else if (data_type == MDAIO_TYPE_FLOAT64)
+        return mdaPwriteData((const double*)data, n, H, fd, offset);
+    else if (data_type == MDAIO_TYPE_UINT32)
+        return mdaPwriteData((const uint32_t*)data, n, H, fd, offset);
+    else
+        return 0;
+}
+
+bigint mda_convert_data(void* data, int data_type, struct MDAIO_HEADER* H, bigint n, const void* input_buffer)
+{
+    if (data_type == MDAIO_TYPE_BYTE)
+        return mda_convert_byte((unsigned char*)data, H, n, input_buffer);
+    else if (data_type == MDAIO_TYPE_FLOAT32)
+        return mda_convert_float32((float*)data, H, n, input_buffer);
+    else if (data_type == MDAIO_TYPE_INT16)
+        return mda_convert_int16((int16_t*)data, H, n, input_buffer);
+    else if (data_type == MDAIO_TYPE_INT32)
+        return mda_convert_int32((int32_t*)data, H, n, input_buffer);
+    else if (data_type == MDAIO_TYPE_UINT16)
+        return mda_convert_uint16((uint16_t*)data, H, n, input_buffer);
+    else if (data_type == MDAIO_TYPE_FLOAT64)
+        return mda_convert_float64((double*)data, H, n, input_buffer);
+    else if (data_type == MDAIO_TYPE_UINT32)
+        return mda_convert_uint32((uint32_t*)data, H, n, input_buffer);
+    else
+        return 0;
+}
+
+//seconds per call of fn(dst, src, n), repeated for at least a quarter of a second
+template <typename Function>
+static double mda_seconds_per_call(Function fn, void* dst, const void* src, bigint n)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    bigint num_calls = 0;
+    do {
+        fn(dst, src, n);
+        num_calls++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < 0.25);
+    return elapsed / num_calls;
+}
+
+void mda_convert_benchmark(bigint n)
+{
+    struct Pair {
+        const char* name;
+        int source_type, target_type;
+        void (*scalar)(void*, const void*, bigint);
+    };
+    Pair pairs[] = {
+        { "int16->float32", MDAIO_TYPE_INT16, MDAIO_TYPE_FLOAT32, [](void* dst, const void* src, bigint num) { convert_int16_float32_scalar((float*)dst, (const int16_t*)src, num); } },
+        { "int16->float64", MDAIO_TYPE_INT16, MDAIO_TYPE_FLOAT64, [](void* dst, const void* src, bigint num) { convert_int16_float64_scalar((double*)dst, (const int16_t*)src, num); } },
+        { "uint16->float32", MDAIO_TYPE_UINT16, MDAIO_TYPE_FLOAT32, [](void* dst, const void* src, bigint num) { convert_uint16_float32_scalar((float*)dst, (const uint16_t*)src, num); } },
+        { "float32->float64", MDAIO_TYPE_FLOAT32, MDAIO_TYPE_FLOAT64, [](void* dst, const void* src, bigint num) { convert_float32_float64_scalar((double*)dst, (const float*)src, num); } },
+        { "float64->float32", MDAIO_TYPE_FLOAT64, MDAIO_TYPE_FLOAT32, [](void* dst, const void* src, bigint num) { convert_float64_float32_scalar((float*)dst, (const double*)src, num); } },
+        { "float32->int16", MDAIO_TYPE_FLOAT32, MDAIO_TYPE_INT16, [](void* dst, const void* src, bigint num) { convert_float32_int16_scalar((int16_t*)dst, (const float*)src, num); } }
+    };
+
+    printf("mda_convert_benchmark: %ld entries, %s kernels\n", (long)n, mda_convert_kernels().name);
+    printf("%-18s %10s %10s\n", "conversion", "scalar", mda_convert_kernels().name);
+    //values that every type can hold exactly
+    std::vector<double> values(n);
+    for (bigint i = 0; i < n; i++)
+        values[i] = (double)((i * 7919) % 30001);
+    struct MDAIO_HEADER H_values;
+    H_values.data_type = MDAIO_TYPE_FLOAT64;
+    for (const Pair& P : pairs) {
+        int source_bytes = mda_get_num_bytes_per_entry(P.source_type);
+        int target_bytes = mda_get_num_bytes_per_entry(P.target_type);
+        std::vector<char> src(n * source_bytes), dst1(n * target_bytes), dst2(n * target_bytes);
+        mda_convert_data(src.data(), P.source_type, &H_values, n, values.data());
+        struct MDAIO_HEADER H;
+        H.data_type = P.source_type;
+        int target_type = P.target_type;
+        double scalar_sec = mda_seconds_per_call(P.scalar, dst1.data(), src.data(), n);
+        double dispatched_sec = mda_seconds_per_call([&H, target_type](void* dst, const void* src0, bigint num) { mda_convert_data(dst, target_type, &H, num, src0); }, dst2.data(), src.data(), n);
+        //bytes read and written
+        double bytes = (double)n * (source_bytes + target_bytes);
+        printf("%-18s %10.2f %10.2f%s\n", P.name, bytes * 1e-9 / scalar_sec, bytes * 1e-9 / dispatched_sec, (dst1 == dst2) ? "" : " MISMATCH");
+    }
+    printf("(GB/s of data read and written)\n");
+}
+
 void mda_copy_header(struct MDAIO_HEADER* ret, const struct MDAIO_HEADER* X)
 {
     std::memcpy(ret, X, sizeof(*ret));
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mdamemorybudget.h"
+#include <icounter.h>
+#include <objectregistry.h>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+static QMutex s_mutex;
+static QWaitCondition s_released;
+static std::atomic<bigint> s_limit(0); //changed under s_mutex
+static std::atomic<bigint> s_used(0);
+static std::atomic<int> s_num_waiters(0); //changed under s_mutex
+static std::atomic<int> s_default_policy(MdaMemoryBudget::FailWhenExceeded);
+static std::atomic<int> s_wait_timeout(-1);
+
+static int& thread_policy_ref()
+{
+    //-1 means the thread follows the default policy
+    static thread_local int policy = -1;
+    return policy;
+}
+
+static IIntCounter* usage_counter(const char* subsystem)
+{
+    //the subsystem names are string literals, so the pointer identifies them. Looked up on the first use of each subsystem in each thread,
+    //which keeps the counter manager (and the formatting of the name) off the allocation path
+    static thread_local QHash<const char*, IIntCounter*> counters;
+    auto it = counters.constFind(subsystem);
+    if (it != counters.constEnd())
+        return it.value();
+    IIntCounter* counter = nullptr;
+    ICounterManager* manager = ObjectRegistry::getObject<ICounterManager>();
+    if (manager)
+        counter = static_cast<IIntCounter*>(manager->counter(QString("%1_budget_bytes").arg(subsystem)));
+    counters[subsystem] = counter;
+    return counter;
+}
+
+static void add_to_usage_counter(const char* subsystem, bigint val)
+{
+    IIntCounter* counter = usage_counter(subsystem);
+    if (counter)
+        counter->add(val);
+}
+
+void MdaMemoryBudget::setLimit(bigint num_bytes)
+{
+    QMutexLocker locker(&s_mutex);
+    s_limit = qMax(num_bytes, (bigint)0);
+    //a higher limit may let waiting threads through
+    s_released.wakeAll();
+}
+
+bigint MdaMemoryBudget::limit()
+{
+    return s_limit;
+}
+
+bigint MdaMemoryBudget::usedBytes()
+{
+    return s_used;
+}
+
+void MdaMemoryBudget::setDefaultPolicy(MdaMemoryBudget::Policy policy)
+{
+    s_default_policy = policy;
+}
+
+void MdaMemoryBudget::setThreadPolicy(MdaMemoryBudget::Policy policy)
+{
+    thread_policy_ref() = policy;
+}
+
+MdaMemoryBudget::Policy MdaMemoryBudget::threadPolicy()
+{
+    int policy = thread_policy_ref();
+    if (policy < 0)
+        policy = s_default_policy;
+    return (Policy)policy;
+}
+
+void MdaMemoryBudget::setWaitTimeout(int msec)
+{
+    s_wait_timeout = msec;
+}
+
+bool MdaMemoryBudget::acquire(bigint num_bytes, const char* subsystem)
+{
+    if (num_bytes <= 0)
+        return true;
+    if (s_limit == 0) {
+        //no limit: nothing to check and nobody to wait for
+        s_used += num_bytes;
+        add_to_usage_counter(subsystem, num_bytes);
+        return true;
+    }
+    {
+        QMutexLocker locker(&s_mutex);
+        if (s_limit > 0) {
+            if (num_bytes > s_limit)
+                return false;
+            if (s_used + num_bytes > s_limit) {
+                if (threadPolicy() == FailWhenExceeded)
+                    return false;
+                int timeout = s_wait_timeout;
+                QElapsedTimer timer;
+                timer.start();
+                //counted before s_used is checked again, so that release() either sees the waiter or the waiter sees the released bytes
+                s_num_waiters++;
+                bool timed_out = false;
+                while ((s_limit > 0) && (s_used + num_bytes > s_limit)) {
+                    if (timeout < 0) {
+                        s_released.wait(&s_mutex);
+                        continue;
+                    }
+                    qint64 remaining = timeout - timer.elapsed();
+                    if (remaining <= 0) {
+                        timed_out = true;
+                        break;
+                    }
+                    s_released.wait(&s_mutex, remaining);
+                }
+                s_num_waiters--;
+                if (timed_out)
+                    return false;
+            }
+        }
+        s_used += num_bytes;
+    }
+    add_to_usage_counter(subsystem, num_bytes);
+    return true;
+}
+
+void MdaMemoryBudget::charge(bigint num_bytes, const char* subsystem)
+{
+    if (num_bytes <= 0)
+        return;
+    s_used += num_bytes;
+    add_to_usage_counter(subsystem, num_bytes);
+}
+
+void MdaMemoryBudget::release(bigint num_bytes, const char* subsystem)
+{
+    if (num_bytes <= 0)
+        return;
+    s_used -= num_bytes;
+    if (s_num_waiters > 0) {
+        QMutexLocker locker(&s_mutex);
+        s_released.wakeAll();
+    }
+    add_to_usage_counter(subsystem, -num_bytes);
+}
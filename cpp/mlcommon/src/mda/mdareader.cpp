@@ -28,17 +28,36 @@ public:
         : q(qq)
         , device(dev)
         , ownsDevice(false)
+        , stream(0)
+        , total_size(0)
+        , position(0)
     {
         if (_mdaReaderFactories->isEmpty()) {
             _mdaReaderFactories->append(QSharedPointer<MdaIOHandlerFactory>(new MdaIOHandlerMDAFactory));
             _mdaReaderFactories->append(QSharedPointer<MdaIOHandlerFactory>(new MdaIOHandlerCSVFactory));
         }
     }
+    ~MdaReaderPrivate()
+    {
+        delete stream;
+    }
 
     MdaReader* q;
     QIODevice* device;
     QByteArray format;
     bool ownsDevice;
+
+    //incremental reading
+    MdaIOHandlerMDA* stream;
+    MdaIOHandlerMDA::Header header;
+    bigint total_size;
+    bigint position;
+
+    void resetStream();
+    template <typename T>
+    bigint readNext(T* data, bigint max_entries);
+    template <typename T>
+    bool readNextChunk(T* chunk, bigint num_timepoints);
 };
 
 MdaReader::MdaReader()
@@ -144,6 +163,7 @@ bool MdaReader::read(Mda32* mda)
 
 void MdaReader::setDevice(QIODevice* dev)
 {
+    d->resetStream();
     if (d->device && d->ownsDevice) {
         d->device->deleteLater();
         d->device = 0;
@@ -154,6 +174,7 @@ void MdaReader::setDevice(QIODevice* dev)
 
 void MdaReader::setFileName(const QString& fileName)
 {
+    d->resetStream();
     if (d->device && d->ownsDevice) {
         d->device->deleteLater();
         d->device = 0;
@@ -162,19 +183,140 @@ void MdaReader::setFileName(const QString& fileName)
     d->ownsDevice = true;
 }
 
+void MdaReaderPrivate::resetStream()
+{
+    delete stream;
+    stream = 0;
+    total_size = 0;
+    position = 0;
+}
+
+template <typename T>
+bigint MdaReaderPrivate::readNext(T* data, bigint max_entries)
+{
+    if (!stream)
+        return -1;
+    bigint num = qMin(max_entries, total_size - position);
+    if (num <= 0)
+        return 0;
+    if (!stream->readEntries(header.data_type, data, num))
+        return -1;
+    position += num;
+    return num;
+}
+
+template <typename T>
+bool MdaReaderPrivate::readNextChunk(T* chunk, bigint num_timepoints)
+{
+    if ((!stream) || (num_timepoints <= 0))
+        return false;
+    bigint N1 = header.dims[0];
+    if (N1 <= 0)
+        return false;
+    bigint num = qMin(num_timepoints, (total_size - position) / N1);
+    if (num <= 0)
+        return false;
+    if (!chunk->allocateUninitialized(N1, num))
+        return false;
+    return (readNext(chunk->dataPtr(), N1 * num) == N1 * num);
+}
+
+bool MdaReader::readHeader()
+{
+    d->resetStream();
+    if (!device())
+        return false;
+    if (!device()->isOpen() && !device()->open(QIODevice::ReadOnly))
+        return false;
+    MdaIOHandlerMDA* handler = new MdaIOHandlerMDA(device(), format());
+    if ((!handler->canRead()) || (!handler->readHeader(&d->header))) {
+        delete handler;
+        return false;
+    }
+    d->stream = handler;
+    d->total_size = 1;
+    for (int i = 0; i < d->header.num_dims; i++)
+        d->total_size *= d->header.dims[i];
+    return true;
+}
+
+QVector<bigint> MdaReader::dims() const
+{
+    QVector<bigint> ret;
+    if (!d->stream)
+        return ret;
+    for (int i = 0; i < d->header.num_dims; i++)
+        ret << d->header.dims[i];
+    return ret;
+}
+
+bigint MdaReader::totalSize() const
+{
+    return d->total_size;
+}
+
+bigint MdaReader::position() const
+{
+    return d->position;
+}
+
+bool MdaReader::atEnd() const
+{
+    return ((!d->stream) || (d->position >= d->total_size));
+}
+
+bigint MdaReader::readNext(double* data, bigint max_entries)
+{
+    return d->readNext(data, max_entries);
+}
+
+bigint MdaReader::readNext(float* data, bigint max_entries)
+{
+    return d->readNext(data, max_entries);
+}
+
+bool MdaReader::readNext(Mda* chunk, bigint num_timepoints)
+{
+    return d->readNextChunk(chunk, num_timepoints);
+}
+
+bool MdaReader::readNext(Mda32* chunk, bigint num_timepoints)
+{
+    return d->readNextChunk(chunk, num_timepoints);
+}
+
 class MdaWriterPrivate {
 public:
     MdaWriterPrivate(MdaWriter* qq, QIODevice* dev = 0)
         : q(qq)
         , device(dev)
         , ownsDevice(false)
+        , stream(0)
+        , total_size(0)
+        , position(0)
+        , closeAfterWrite(false)
+    {
+    }
+    ~MdaWriterPrivate()
     {
+        delete stream;
     }
 
     MdaWriter* q;
     QIODevice* device;
     QByteArray format;
     bool ownsDevice;
+
+    //incremental writing
+    MdaIOHandlerMDA* stream;
+    MdaIOHandlerMDA::Header header;
+    bigint total_size;
+    bigint position;
+    bool closeAfterWrite;
+
+    void resetStream();
+    template <typename T>
+    bool writeNext(const T* data, bigint num_entries);
 };
 
 MdaWriter::MdaWriter()
@@ -231,6 +373,7 @@ QByteArray MdaWriter::format() const
 
 void MdaWriter::setDevice(QIODevice* dev)
 {
+    d->resetStream();
     if (d->device && d->ownsDevice) {
         d->device->deleteLater();
         d->device = 0;
@@ -241,6 +384,7 @@ void MdaWriter::setDevice(QIODevice* dev)
 
 void MdaWriter::setFileName(const QString& fileName)
 {
+    d->resetStream();
     if (d->device && d->ownsDevice) {
         d->device->deleteLater();
         d->device = 0;
@@ -291,6 +435,99 @@ bool MdaWriter::write(const Mda32& mda)
     return false;
 }
 
+void MdaWriterPrivate::resetStream()
+{
+    delete stream;
+    stream = 0;
+    total_size = 0;
+    position = 0;
+}
+
+template <typename T>
+bool MdaWriterPrivate::writeNext(const T* data, bigint num_entries)
+{
+    if ((!stream) || (num_entries < 0) || (position + num_entries > total_size))
+        return false;
+    if (!stream->writeEntries(header.data_type, data, num_entries))
+        return false;
+    position += num_entries;
+    return true;
+}
+
+bool MdaWriter::writeHeader(const QVector<bigint>& dims)
+{
+    d->resetStream();
+    if (!device())
+        return false;
+    d->closeAfterWrite = !device()->isOpen();
+    if (!device()->isOpen() && !device()->open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    MdaIOHandlerMDA* handler = new MdaIOHandlerMDA(device(), format());
+    if ((!handler->canWrite()) || (!handler->headerFromFormat(&d->header)) || (dims.isEmpty()) || (dims.count() > handler->maxDims)) {
+        delete handler;
+        return false;
+    }
+    d->header.num_dims = dims.count();
+    d->header.dims.resize(dims.count());
+    bigint total_size = 1;
+    for (int i = 0; i < dims.count(); i++) {
+        if (dims[i] < 0) {
+            delete handler;
+            return false;
+        }
+        d->header.dims[i] = dims[i];
+        total_size *= dims[i];
+    }
+    if (!handler->writeHeader(d->header)) {
+        delete handler;
+        return false;
+    }
+    d->stream = handler;
+    d->total_size = total_size;
+    return true;
+}
+
+bool MdaWriter::writeNext(const double* data, bigint num_entries)
+{
+    return d->writeNext(data, num_entries);
+}
+
+bool MdaWriter::writeNext(const float* data, bigint num_entries)
+{
+    return d->writeNext(data, num_entries);
+}
+
+bool MdaWriter::writeNext(const Mda& chunk)
+{
+    return d->writeNext(chunk.constDataPtr(), chunk.totalSize());
+}
+
+bool MdaWriter::writeNext(const Mda32& chunk)
+{
+    return d->writeNext(chunk.constDataPtr(), chunk.totalSize());
+}
+
+bigint MdaWriter::position() const
+{
+    return d->position;
+}
+
+bool MdaWriter::finish()
+{
+    if (!d->stream)
+        return false;
+    bool complete = (d->position == d->total_size);
+    d->resetStream();
+    if (QSaveFile* f = qobject_cast<QSaveFile*>(device())) {
+        if (!complete)
+            f->cancelWriting(); //the incomplete file is discarded
+        return (f->commit() && complete);
+    }
+    if (d->closeAfterWrite)
+        device()->close();
+    return complete;
+}
+
 MdaIOHandler::MdaIOHandler()
     : dev(0)
 {
@@ -318,6 +555,36 @@ MdaIOHandlerMDA::MdaIOHandlerMDA(QIODevice* d, const QByteArray& fmt)
     setDevice(d);
 }
 
+bool MdaIOHandlerMDA::readBlock(char* data, qint64 num_bytes)
+{
+    while (num_bytes > 0) {
+        qint64 num_read = device()->read(data, num_bytes);
+        if (num_read < 0)
+            return false;
+        if (num_read == 0) {
+            //pipes and sockets may not have the rest of the data yet
+            if ((!device()->isSequential()) || (!device()->waitForReadyRead(-1)))
+                return false;
+            continue;
+        }
+        data += num_read;
+        num_bytes -= num_read;
+    }
+    return true;
+}
+
+bool MdaIOHandlerMDA::writeBlock(const char* data, qint64 num_bytes)
+{
+    while (num_bytes > 0) {
+        qint64 num_written = device()->write(data, num_bytes);
+        if (num_written <= 0)
+            return false;
+        data += num_written;
+        num_bytes -= num_written;
+    }
+    return true;
+}
+
 bool MdaIOHandlerMDA::canRead() const
 {
     if (!device())
@@ -348,275 +615,164 @@ bool MdaIOHandlerMDA::canWrite() const
     return false;
 }
 
-bool MdaIOHandlerMDA::read(Mda* mda)
+bool MdaIOHandlerMDA::readHeader(Header* header)
 {
     bool use64bitdims = false;
-    Header header;
-    if (!readLE(&header.data_type))
-        return false;
-    if (!readLE(&header.num_bytes_per_entry))
+    if (!readLE(&header->data_type))
         return false;
-    if (!readLE(&header.num_dims))
+    if (!readLE(&header->num_bytes_per_entry))
         return false;
-    if (header.num_dims == 0 || header.num_dims > maxDims)
+    if (!readLE(&header->num_dims))
         return false;
-    if (header.num_dims < 0) {
+    if (header->num_dims < 0) {
         use64bitdims = true;
-        header.num_dims = -header.num_dims;
-    }
-    header.dims.resize(header.num_dims);
-    if (use64bitdims) {
-        for (size_t i = 0; i < (size_t)header.num_dims; ++i) {
-            if (!readLE(header.dims.data() + i))
-                return false;
-        }
+        header->num_dims = -header->num_dims;
     }
-    else {
-        int32_t data;
-        for (size_t i = 0; i < (size_t)header.num_dims; ++i) {
-            if (!readLE(&data))
-                return false;
-            header.dims[i] = data;
-        }
-    }
-    while (header.dims.size() < 6)
-        header.dims.append(1);
-    if (!mda->allocate(header.dims[0], header.dims[1], header.dims[2], header.dims[3], header.dims[4], header.dims[5]))
+    if (header->num_dims == 0 || header->num_dims > maxDims)
         return false;
-    switch (header.data_type) {
-    case Byte:
-        return readData<unsigned char>(mda->dataPtr(), mda->totalSize());
-    case Float32:
-        return readData<float>(mda->dataPtr(), mda->totalSize());
-    case Int16:
-        return readData<int16_t>(mda->dataPtr(), mda->totalSize());
-    case Int32:
-        return readData<int32_t>(mda->dataPtr(), mda->totalSize());
-    case UInt16:
-        return readData<uint16_t>(mda->dataPtr(), mda->totalSize());
-    case Float64:
-        return readData<double>(mda->dataPtr(), mda->totalSize());
-    case UInt32:
-        return readData<uint32_t>(mda->dataPtr(), mda->totalSize());
-    default:
-        return false;
-    }
-    return true;
-}
-
-bool MdaIOHandlerMDA::read(Mda32* mda)
-{
-    bool use64bitdims = false;
-    Header header;
-    if (!readLE(&header.data_type))
-        return false;
-    if (!readLE(&header.num_bytes_per_entry))
-        return false;
-    if (!readLE(&header.num_dims))
-        return false;
-    if (header.num_dims == 0 || header.num_dims > maxDims)
-        return false;
-    if (header.num_dims < 0) {
-        use64bitdims = true;
-        header.num_dims = -header.num_dims;
-    }
-    header.dims.resize(header.num_dims);
+    header->dims.resize(header->num_dims);
     if (use64bitdims) {
-        for (size_t i = 0; i < (size_t)header.num_dims; ++i) {
-            if (!readLE(header.dims.data() + i))
+        for (size_t i = 0; i < (size_t)header->num_dims; ++i) {
+            if (!readLE(header->dims.data() + i))
                 return false;
         }
     }
     else {
         int32_t data;
-        for (size_t i = 0; i < (size_t)header.num_dims; ++i) {
+        for (size_t i = 0; i < (size_t)header->num_dims; ++i) {
             if (!readLE(&data))
                 return false;
-            header.dims[i] = data;
+            header->dims[i] = data;
         }
     }
-    while (header.dims.size() < 6)
-        header.dims.append(1);
-    if (!mda->allocate(header.dims[0], header.dims[1], header.dims[2], header.dims[3], header.dims[4], header.dims[5]))
-        return false;
-    switch (header.data_type) {
-    case Byte:
-        return readData<unsigned char>(mda->dataPtr(), mda->totalSize());
-    case Float32:
-        return readData<float>(mda->dataPtr(), mda->totalSize());
-    case Int16:
-        return readData<int16_t>(mda->dataPtr(), mda->totalSize());
-    case Int32:
-        return readData<int32_t>(mda->dataPtr(), mda->totalSize());
-    case UInt16:
-        return readData<uint16_t>(mda->dataPtr(), mda->totalSize());
-    case Float64:
-        return readData<double>(mda->dataPtr(), mda->totalSize());
-    case UInt32:
-        return readData<uint32_t>(mda->dataPtr(), mda->totalSize());
-    default:
-        return false;
-    }
+    while (header->dims.size() < 6)
+        header->dims.append(1);
     return true;
 }
 
-bool MdaIOHandlerMDA::write(const Mda& mda)
+bool MdaIOHandlerMDA::headerFromFormat(Header* header) const
 {
-    Header header;
     if (format().toLower().startsWith("mda.")) {
         QByteArray subFormat = format().toLower().mid(4);
         if (subFormat == "byte") {
-            header.data_type = Byte;
-            header.num_bytes_per_entry = 1;
+            header->data_type = Byte;
+            header->num_bytes_per_entry = 1;
         }
         else if (subFormat == "float" || subFormat == "float32") {
-            header.data_type = Float32;
-            header.num_bytes_per_entry = 4;
+            header->data_type = Float32;
+            header->num_bytes_per_entry = 4;
         }
         else if (subFormat == "int16") {
-            header.data_type = Int16;
-            header.num_bytes_per_entry = 2;
+            header->data_type = Int16;
+            header->num_bytes_per_entry = 2;
         }
         else if (subFormat == "int" || subFormat == "int32") {
-            header.data_type = Int32;
-            header.num_bytes_per_entry = 4;
+            header->data_type = Int32;
+            header->num_bytes_per_entry = 4;
         }
         else if (subFormat == "uint16") {
-            header.data_type = UInt16;
-            header.num_bytes_per_entry = 2;
+            header->data_type = UInt16;
+            header->num_bytes_per_entry = 2;
         }
         else if (subFormat == "double" || subFormat == "float64") {
-            header.data_type = Float64;
-            header.num_bytes_per_entry = 8;
+            header->data_type = Float64;
+            header->num_bytes_per_entry = 8;
         }
         else if (subFormat == "uint" || subFormat == "uint32") {
-            header.data_type = UInt32;
-            header.num_bytes_per_entry = 4;
+            header->data_type = UInt32;
+            header->num_bytes_per_entry = 4;
         }
         else {
             return false;
         }
     }
     else {
-        header.data_type = Float64;
-        header.num_bytes_per_entry = 8;
+        header->data_type = Float64;
+        header->num_bytes_per_entry = 8;
     }
-    header.num_dims = mda.ndims();
-    header.dims.resize(header.num_dims);
+    return true;
+}
+
+bool MdaIOHandlerMDA::writeHeader(const Header& header)
+{
     bool use64bitdims = false;
-    for (int i = 0; i < header.num_dims; ++i) {
-        header.dims[i] = mda.size(i);
-        if (mda.size(i) > 2e9) {
+    for (int i = 0; i < header.dims.count(); ++i) {
+        if (header.dims[i] > 2e9) {
             use64bitdims = true;
         }
     }
+    int32_t num_dims = header.dims.count();
     if (use64bitdims)
-        header.num_dims = -header.num_dims;
-    // commit the header
-    writeLE(header.data_type);
-    writeLE(header.num_bytes_per_entry);
-    writeLE(header.num_dims);
+        num_dims = -num_dims;
+    if (!writeLE(header.data_type))
+        return false;
+    if (!writeLE(header.num_bytes_per_entry))
+        return false;
+    if (!writeLE(num_dims))
+        return false;
     if (use64bitdims) {
-        for (uint64_t dim : header.dims)
-            writeLE(dim);
+        for (uint64_t dim : header.dims) {
+            if (!writeLE(dim))
+                return false;
+        }
     }
     else {
-        for (int32_t dim : header.dims)
-            writeLE(dim);
-    }
-    // commit data
-    switch (header.data_type) {
-    case Byte:
-        return writeData<unsigned char>(mda.constDataPtr(), mda.totalSize());
-    case Float32:
-        return writeData<float>(mda.constDataPtr(), mda.totalSize());
-    case Int16:
-        return writeData<int16_t>(mda.constDataPtr(), mda.totalSize());
-    case Int32:
-        return writeData<int32_t>(mda.constDataPtr(), mda.totalSize());
-    case UInt16:
-        return writeData<uint16_t>(mda.constDataPtr(), mda.totalSize());
-    case Float64:
-        return writeData<double>(mda.constDataPtr(), mda.totalSize());
-    case UInt32:
-        return writeData<uint32_t>(mda.constDataPtr(), mda.totalSize());
-    default:
+        for (int32_t dim : header.dims) {
+            if (!writeLE(dim))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool MdaIOHandlerMDA::read(Mda* mda)
+{
+    Header header;
+    if (!readHeader(&header))
+        return false;
+    if (!mda->allocate(header.dims[0], header.dims[1], header.dims[2], header.dims[3], header.dims[4], header.dims[5]))
+        return false;
+    return readEntries(header.data_type, mda->dataPtr(), mda->totalSize());
+}
+
+bool MdaIOHandlerMDA::read(Mda32* mda)
+{
+    Header header;
+    if (!readHeader(&header))
+        return false;
+    if (!mda->allocate(header.dims[0], header.dims[1], header.dims[2], header.dims[3], header.dims[4], header.dims[5]))
+        return false;
+    return readEntries(header.data_type, mda->dataPtr(), mda->totalSize());
+}
+
+bool MdaIOHandlerMDA::write(const Mda& mda)
+{
+    Header header;
+    if (!headerFromFormat(&header))
         return false;
+    header.num_dims = mda.ndims();
+    header.dims.resize(header.num_dims);
+    for (int i = 0; i < header.num_dims; ++i) {
+        header.dims[i] = mda.size(i);
     }
+    if (!writeHeader(header))
+        return false;
+    return writeEntries(header.data_type, mda.constDataPtr(), mda.totalSize());
 }
 
 bool MdaIOHandlerMDA::write(const Mda32& mda)
 {
     Header header;
-    if (format().toLower().startsWith("mda.")) {
-        QByteArray subFormat = format().toLower().mid(4);
-        if (subFormat == "byte") {
-            header.data_type = Byte;
-            header.num_bytes_per_entry = 1;
-        }
-        else if (subFormat == "float" || subFormat == "float32") {
-            header.data_type = Float32;
-            header.num_bytes_per_entry = 4;
-        }
-        else if (subFormat == "int16") {
-            header.data_type = Int16;
-            header.num_bytes_per_entry = 2;
-        }
-        else if (subFormat == "int" || subFormat == "int32") {
-            header.data_type = Int32;
-            header.num_bytes_per_entry = 4;
-        }
-        else if (subFormat == "uint16") {
-            header.data_type = UInt16;
-            header.num_bytes_per_entry = 2;
-        }
-        else if (subFormat == "double" || subFormat == "float64") {
-            header.data_type = Float64;
-            header.num_bytes_per_entry = 8;
-        }
-        else if (subFormat == "uint" || subFormat == "uint32") {
-            header.data_type = UInt32;
-            header.num_bytes_per_entry = 4;
-        }
-        else {
-            return false;
-        }
-    }
-    else {
-        header.data_type = Float64;
-        header.num_bytes_per_entry = 8;
-    }
+    if (!headerFromFormat(&header))
+        return false;
     header.num_dims = mda.ndims();
     header.dims.resize(header.num_dims);
     for (int i = 0; i < header.num_dims; ++i) {
         header.dims[i] = mda.size(i);
     }
-    // commit the header
-    writeLE(header.data_type);
-    writeLE(header.num_bytes_per_entry);
-    writeLE(header.num_dims);
-    for (int32_t dim : header.dims)
-        writeLE(dim);
-
-    // commit data
-    switch (header.data_type) {
-    case Byte:
-        return writeData<unsigned char>(mda.constDataPtr(), mda.totalSize());
-    case Float32:
-        return writeData<float>(mda.constDataPtr(), mda.totalSize());
-    case Int16:
-        return writeData<int16_t>(mda.constDataPtr(), mda.totalSize());
-    case Int32:
-        return writeData<int32_t>(mda.constDataPtr(), mda.totalSize());
-    case UInt16:
-        return writeData<uint16_t>(mda.constDataPtr(), mda.totalSize());
-    case Float64:
-        return writeData<double>(mda.constDataPtr(), mda.totalSize());
-    case UInt32:
-        return writeData<uint32_t>(mda.constDataPtr(), mda.totalSize());
-    default:
+    if (!writeHeader(header))
         return false;
-    }
+    return writeEntries(header.data_type, mda.constDataPtr(), mda.totalSize());
 }
 
 MdaIOHandlerCSV::MdaIOHandlerCSV(QIODevice* device, const QByteArray& format)
@@ -0,0 +1,528 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mdastats.h"
+#include "mdamemorybudget.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QVector>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#define DEFAULT_CHUNK_SIZE (4 * 1024 * 1024)
+#define DEFAULT_COMPRESSION 100
+
+namespace {
+
+/*
+ * Merging t-digest (Dunning & Ertl). Values are collected in a buffer and,
+ * when it fills up, merged with the existing centroids into at most about
+ * compression centroids, which are small near the tails (where quantile
+ * estimates need to be precise) and large in the middle.
+ */
+class MdaTDigest {
+public:
+    struct Centroid {
+        double mean;
+        double weight;
+        bool operator<(const Centroid& other) const { return mean < other.mean; }
+    };
+
+    void setCompression(double compression)
+    {
+        m_compression = qMax(compression, 10.0);
+    }
+    void add(double x)
+    {
+        m_buffer.push_back(x);
+        if ((double)m_buffer.size() >= 2 * m_compression)
+            compress();
+    }
+    void merge(const MdaTDigest& other)
+    {
+        m_incoming.insert(m_incoming.end(), other.m_centroids.begin(), other.m_centroids.end());
+        for (double x : other.m_buffer) {
+            Centroid C = { x, 1 };
+            m_incoming.push_back(C);
+            m_min = qMin(m_min, x);
+            m_max = qMax(m_max, x);
+        }
+        m_incoming.insert(m_incoming.end(), other.m_incoming.begin(), other.m_incoming.end());
+        m_min = qMin(m_min, other.m_min);
+        m_max = qMax(m_max, other.m_max);
+        if ((double)m_incoming.size() >= 10 * m_compression)
+            compress();
+    }
+    void compress();
+    ///Requires compress() to have been called after the last add() or merge()
+    double quantile(double p) const;
+
+private:
+    double m_compression = DEFAULT_COMPRESSION;
+    std::vector<Centroid> m_centroids; //sorted
+    std::vector<double> m_buffer; //values not yet merged into the centroids
+    std::vector<Centroid> m_incoming; //centroids from merge() not yet merged
+    double m_total_weight = 0; //of m_centroids
+    double m_min = std::numeric_limits<double>::infinity();
+    double m_max = -std::numeric_limits<double>::infinity();
+
+    double weight_limit(double weight_so_far) const;
+};
+
+double MdaTDigest::weight_limit(double weight_so_far) const
+{
+    //the k1 scale function k(q)=compression/(2pi)*asin(2q-1): a centroid may span at most one unit of k
+    double q0 = weight_so_far / m_total_weight;
+    double k = m_compression / (2 * M_PI) * asin(qBound(-1.0, 2 * q0 - 1, 1.0)) + 1;
+    if (k >= m_compression / 4)
+        return m_total_weight;
+    return m_total_weight * (sin(k * 2 * M_PI / m_compression) + 1) / 2;
+}
+
+void MdaTDigest::compress()
+{
+    if ((m_buffer.empty()) && (m_incoming.empty()))
+        return;
+    std::vector<Centroid> all;
+    all.reserve(m_centroids.size() + m_incoming.size() + m_buffer.size());
+    all.insert(all.end(), m_centroids.begin(), m_centroids.end());
+    all.insert(all.end(), m_incoming.begin(), m_incoming.end());
+    for (double x : m_buffer) {
+        Centroid C = { x, 1 };
+        all.push_back(C);
+        m_min = qMin(m_min, x);
+        m_max = qMax(m_max, x);
+    }
+    m_buffer.clear();
+    m_incoming.clear();
+    std::sort(all.begin(), all.end());
+
+    m_total_weight = 0;
+    for (const Centroid& C : all)
+        m_total_weight += C.weight;
+    m_centroids.clear();
+    Centroid current = all[0];
+    double weight_so_far = 0;
+    double limit = weight_limit(0);
+    for (size_t i = 1; i < all.size(); i++) {
+        if (weight_so_far + current.weight + all[i].weight <= limit) {
+            current.weight += all[i].weight;
+            current.mean += (all[i].mean - current.mean) * all[i].weight / current.weight;
+        }
+        else {
+            m_centroids.push_back(current);
+            weight_so_far += current.weight;
+            limit = weight_limit(weight_so_far);
+            current = all[i];
+        }
+    }
+    m_centroids.push_back(current);
+}
+
+double MdaTDigest::quantile(double p) const
+{
+    if (m_centroids.empty())
+        return 0;
+    double target = qBound(0.0, p, 1.0) * m_total_weight;
+    //interpolate linearly between the centers of neighboring centroids, and between the extremes and the outer centers
+    const Centroid& first = m_centroids.front();
+    if (target < first.weight / 2) {
+        if (first.weight <= 1)
+            return first.mean;
+        return m_min + (first.mean - m_min) * target / (first.weight / 2);
+    }
+    double cum = first.weight / 2;
+    for (size_t i = 0; i + 1 < m_centroids.size(); i++) {
+        double next = cum + (m_centroids[i].weight + m_centroids[i + 1].weight) / 2;
+        if (target < next) {
+            double frac = (target - cum) / (next - cum);
+            return m_centroids[i].mean + frac * (m_centroids[i + 1].mean - m_centroids[i].mean);
+        }
+        cum = next;
+    }
+    const Centroid& last = m_centroids.back();
+    if ((last.weight <= 1) || (m_total_weight <= cum))
+        return last.mean;
+    return last.mean + (m_max - last.mean) * qMin((target - cum) / (m_total_weight - cum), 1.0);
+}
+
+struct ChannelAccumulator {
+    bigint count = 0;
+    bigint num_nan = 0;
+    double mean = 0;
+    double m2 = 0; //sum of squared deviations from the mean
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    MdaTDigest digest;
+
+    //combine with the moments of another set of n values (Chan et al.), which is exact up to rounding
+    void addMoments(bigint n, double mean_b, double m2_b)
+    {
+        if (n == 0)
+            return;
+        if (count == 0) {
+            count = n;
+            mean = mean_b;
+            m2 = m2_b;
+            return;
+        }
+        double delta = mean_b - mean;
+        bigint total = count + n;
+        mean += delta * n / total;
+        m2 += m2_b + delta * delta * ((double)count * n / total);
+        count = total;
+    }
+    void merge(const ChannelAccumulator& other)
+    {
+        addMoments(other.count, other.mean, other.m2);
+        num_nan += other.num_nan;
+        min = qMin(min, other.min);
+        max = qMax(max, other.max);
+        digest.merge(other.digest);
+    }
+    MdaStatsSummary summary(const QVector<double>& probabilities)
+    {
+        MdaStatsSummary ret;
+        ret.count = count;
+        ret.num_nan = num_nan;
+        if (count == 0)
+            return ret;
+        ret.min = min;
+        ret.max = max;
+        ret.mean = mean;
+        if (count >= 2)
+            ret.stdev = sqrt(m2 / (count - 1));
+        digest.compress();
+        for (int i = 0; i < probabilities.count(); i++)
+            ret.quantiles << digest.quantile(probabilities[i]);
+        return ret;
+    }
+};
+
+class MdaStatsWorker : public QThread {
+public:
+    //input
+    DiskReadMda X;
+    bigint N1 = 0;
+    bigint M = 0;
+    bigint chunk_cols = 0;
+    std::atomic<bigint>* next_chunk = 0; //shared by the workers
+    MdaMemoryBudget::Policy budget_policy = MdaMemoryBudget::threadPolicy(); //that of the thread calling compute()
+
+    //output
+    QVector<ChannelAccumulator> channels;
+    bool success = true;
+
+    void run()
+    {
+        MdaMemoryBudget::setThreadPolicy(budget_policy);
+        Mda chunk;
+        QVector<bigint> counts(N1);
+        QVector<double> sums(N1), means(N1), m2s(N1);
+        ChannelAccumulator* acc = channels.data();
+        while (true) {
+            bigint t0 = (*next_chunk)++ * chunk_cols;
+            if (t0 >= M)
+                break;
+            bigint n = qMin(chunk_cols, M - t0);
+            if (!X.readChunk(chunk, 0, t0, N1, n)) {
+                success = false;
+                //make the other workers stop too
+                *next_chunk = M;
+                break;
+            }
+            const double* ptr = chunk.constDataPtr();
+            counts.fill(0);
+            sums.fill(0);
+            for (bigint t = 0; t < n; t++) {
+                const double* col = ptr + N1 * t;
+                for (bigint m = 0; m < N1; m++) {
+                    double v = col[m];
+                    if (v != v) {
+                        acc[m].num_nan++;
+                        continue;
+                    }
+                    counts[m]++;
+                    sums[m] += v;
+                    if (v < acc[m].min)
+                        acc[m].min = v;
+                    if (v > acc[m].max)
+                        acc[m].max = v;
+                    acc[m].digest.add(v);
+                }
+            }
+            //second pass over the chunk (which is in memory) for the squared deviations, avoiding the cancellation of the sum-of-squares formula
+            for (bigint m = 0; m < N1; m++) {
+                means[m] = counts[m] ? sums[m] / counts[m] : 0;
+                m2s[m] = 0;
+            }
+            for (bigint t = 0; t < n; t++) {
+                const double* col = ptr + N1 * t;
+                for (bigint m = 0; m < N1; m++) {
+                    double v = col[m];
+                    if (v == v)
+                        m2s[m] += (v - means[m]) * (v - means[m]);
+                }
+            }
+            for (bigint m = 0; m < N1; m++)
+                acc[m].addMoments(counts[m], means[m], m2s[m]);
+        }
+    }
+};
+} // namespace
+
+class MdaStatisticsPrivate {
+public:
+    MdaStatistics* q;
+
+    QVector<double> m_probabilities;
+    double m_compression = DEFAULT_COMPRESSION;
+    bigint m_chunk_size = DEFAULT_CHUNK_SIZE;
+    int m_num_threads = 0;
+
+    MdaStatsSummary m_global;
+    QVector<MdaStatsSummary> m_channels;
+};
+
+MdaStatistics::MdaStatistics()
+{
+    d = new MdaStatisticsPrivate;
+    d->q = this;
+    d->m_probabilities << 0.001 << 0.01 << 0.5 << 0.99 << 0.999;
+}
+
+MdaStatistics::~MdaStatistics()
+{
+    delete d;
+}
+
+void MdaStatistics::setQuantileProbabilities(const QVector<double>& probabilities)
+{
+    d->m_probabilities = probabilities;
+}
+
+QVector<double> MdaStatistics::quantileProbabilities() const
+{
+    return d->m_probabilities;
+}
+
+void MdaStatistics::setCompression(double compression)
+{
+    d->m_compression = compression;
+}
+
+void MdaStatistics::setChunkSize(bigint num_entries)
+{
+    d->m_chunk_size = num_entries;
+}
+
+void MdaStatistics::setNumThreads(int num_threads)
+{
+    d->m_num_threads = num_threads;
+}
+
+bool MdaStatistics::compute(const DiskReadMda& X)
+{
+    d->m_global = MdaStatsSummary();
+    d->m_channels.clear();
+    bigint N1 = X.N1();
+    if ((N1 <= 0) || (X.totalSize() <= 0))
+        return true;
+    bigint M = X.totalSize() / N1;
+    bigint chunk_cols = qMax(d->m_chunk_size / N1, (bigint)1);
+    bigint num_chunks = (M + chunk_cols - 1) / chunk_cols;
+    int num_threads = d->m_num_threads > 0 ? d->m_num_threads : QThread::idealThreadCount();
+    num_threads = (int)qBound((bigint)1, (bigint)num_threads, num_chunks);
+
+    std::atomic<bigint> next_chunk(0);
+    QList<MdaStatsWorker*> workers;
+    for (int i = 0; i < num_threads; i++) {
+        MdaStatsWorker* W = new MdaStatsWorker;
+        W->X = X;
+        W->N1 = N1;
+        W->M = M;
+        W->chunk_cols = chunk_cols;
+        W->next_chunk = &next_chunk;
+        W->channels.resize(N1);
+        for (bigint m = 0; m < N1; m++)
+            W->channels[m].digest.setCompression(d->m_compression);
+        workers << W;
+    }
+    foreach (MdaStatsWorker* W, workers) {
+        W->start();
+    }
+    bool success = true;
+    foreach (MdaStatsWorker* W, workers) {
+        W->wait();
+        if (!W->success)
+            success = false;
+    }
+    if (!success) {
+        qDeleteAll(workers);
+        return false;
+    }
+
+    QVector<ChannelAccumulator>& channels = workers[0]->channels;
+    for (int i = 1; i < workers.count(); i++) {
+        for (bigint m = 0; m < N1; m++)
+            channels[m].merge(workers[i]->channels[m]);
+    }
+    ChannelAccumulator global;
+    global.digest.setCompression(d->m_compression);
+    d->m_channels.resize(N1);
+    for (bigint m = 0; m < N1; m++) {
+        d->m_channels[m] = channels[m].summary(d->m_probabilities);
+        global.merge(channels[m]);
+    }
+    d->m_global = global.summary(d->m_probabilities);
+    qDeleteAll(workers);
+    return true;
+}
+
+MdaStatsSummary MdaStatistics::global() const
+{
+    return d->m_global;
+}
+
+bigint MdaStatistics::numChannels() const
+{
+    return d->m_channels.count();
+}
+
+MdaStatsSummary MdaStatistics::channel(bigint m) const
+{
+    return d->m_channels.value(m);
+}
+
+QJsonObject MdaStatistics::toJsonObject(bool include_channels) const
+{
+    QJsonObject ret = d->m_global.toJsonObject(d->m_probabilities);
+    ret["num_channels"] = (long long)d->m_channels.count();
+    if (include_channels) {
+        QJsonArray channels;
+        for (int m = 0; m < d->m_channels.count(); m++) {
+            channels.push_back(d->m_channels[m].toJsonObject(d->m_probabilities));
+        }
+        ret["channels"] = channels;
+    }
+    return ret;
+}
+
+QJsonObject MdaStatsSummary::toJsonObject(const QVector<double>& probabilities) const
+{
+    QJsonObject ret;
+    ret["count"] = (long long)count;
+    ret["num_nan"] = (long long)num_nan;
+    ret["min"] = min;
+    ret["max"] = max;
+    ret["mean"] = mean;
+    ret["stdev"] = stdev;
+    QJsonObject Q;
+    for (int i = 0; (i < probabilities.count()) && (i < quantiles.count()); i++) {
+        Q[QString::number(probabilities[i])] = quantiles[i];
+    }
+    ret["quantiles"] = Q;
+    return ret;
+}
+
+static bigint mdastats_count_mismatches(const MdaStatsSummary& S, const QVector<double>& vals, bigint num_nan)
+{
+    //exact values, computed directly
+    QVector<double> sorted = vals;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (int i = 0; i < vals.count(); i++)
+        sum += vals[i];
+    double mean = sum / vals.count();
+    double sumsqr = 0;
+    for (int i = 0; i < vals.count(); i++)
+        sumsqr += (vals[i] - mean) * (vals[i] - mean);
+    double stdev = sqrt(sumsqr / (vals.count() - 1));
+    double median = sorted[sorted.count() / 2]; //the count is odd
+    double range = sorted.last() - sorted.first();
+
+    bigint ret = 0;
+    if ((S.count != vals.count()) || (S.num_nan != num_nan))
+        ret++;
+    if ((S.min != sorted.first()) || (S.max != sorted.last()))
+        ret++;
+    if (fabs(S.mean - mean) > 1e-9 * qMax(fabs(mean), 1.0))
+        ret++;
+    if (fabs(S.stdev - stdev) > 1e-9 * stdev)
+        ret++;
+    //the median is estimated by the t-digest
+    if ((S.quantiles.count() != 1) || (fabs(S.quantiles[0] - median) > 0.01 * range))
+        ret++;
+    return ret;
+}
+
+bool mdastats_unit_test()
+{
+    printf("mdastats_unit_test...\n");
+
+    //channel m holds a permutation of 2000*m+(0..1000), followed by a NaN in the last timepoint
+    bigint N1 = 3;
+    bigint M = 1002;
+    Mda X;
+    X.allocate(N1, M);
+    QVector<QVector<double> > channel_vals(N1);
+    QVector<double> all_vals;
+    for (bigint t = 0; t < M; t++) {
+        for (bigint m = 0; m < N1; m++) {
+            if (t == M - 1) {
+                X.setValue(std::numeric_limits<double>::quiet_NaN(), m, t);
+                continue;
+            }
+            double val = 2000 * m + (t * 397) % (M - 1);
+            X.setValue(val, m, t);
+            channel_vals[m] << val;
+            all_vals << val;
+        }
+    }
+    X.write64("tmp_stats.mda");
+
+    bigint num_mismatches = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        MdaStatistics S;
+        S.setQuantileProbabilities(QVector<double>() << 0.5);
+        if (pass == 0) {
+            S.setNumThreads(1);
+        }
+        else {
+            //many chunks over several threads, so the moments and the t-digests are merged between chunks and threads
+            S.setNumThreads(4);
+            S.setChunkSize(N1 * 37);
+        }
+        if (!S.compute(DiskReadMda("tmp_stats.mda"))) {
+            printf("Problem computing statistics.\n");
+            QFile::remove("tmp_stats.mda");
+            return false;
+        }
+        bigint num = mdastats_count_mismatches(S.global(), all_vals, N1);
+        if (S.numChannels() != N1)
+            num++;
+        for (bigint m = 0; m < qMin(N1, S.numChannels()); m++)
+            num += mdastats_count_mismatches(S.channel(m), channel_vals[m], 1);
+        printf("Number of mismatches in statistics (%s, should be 0): %ld\n", pass == 0 ? "one thread and chunk" : "several threads and chunks", num);
+        num_mismatches += num;
+    }
+    QFile::remove("tmp_stats.mda");
+    return (num_mismatches == 0);
+}
@@ -15,14 +15,17 @@
  */
 #include "usagetracking.h"
 #include <QDebug>
+#include <atomic>
+#include <errno.h>
+#include <unistd.h>
 
 #include "mlcommon.h"
 
 static bigint num_files_open = 0;
 static int64_t num_bytes_allocated = 0;
 static bigint malloc_count = 0;
-static bigint num_bytes_read = 0;
-static bigint num_bytes_written = 0;
+static std::atomic<bigint> num_bytes_read(0);
+static std::atomic<bigint> num_bytes_written(0);
 
 FILE* jfopen(const char* path, const char* mode)
 {
@@ -50,6 +53,47 @@ bigint jfread(void* data, size_t sz, bigint num, FILE* F)
     return ret;
 }
 
+bigint jpread(void* data, size_t sz, bigint num, int fd, bigint offset)
+{
+    //pread may return fewer bytes than requested, so keep going until we have everything or hit the end of the file
+    char* ptr = (char*)data;
+    bigint num_bytes = sz * num;
+    bigint num_bytes_done = 0;
+    while (num_bytes_done < num_bytes) {
+        ssize_t ret = pread(fd, ptr + num_bytes_done, num_bytes - num_bytes_done, offset + num_bytes_done);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (ret == 0)
+            break;
+        num_bytes_done += ret;
+    }
+    num_bytes_read += num_bytes_done;
+    return num_bytes_done / sz;
+}
+
+bigint jpwrite(const void* data, size_t sz, bigint num, int fd, bigint offset)
+{
+    const char* ptr = (const char*)data;
+    bigint num_bytes = sz * num;
+    bigint num_bytes_done = 0;
+    while (num_bytes_done < num_bytes) {
+        ssize_t ret = pwrite(fd, ptr + num_bytes_done, num_bytes - num_bytes_done, offset + num_bytes_done);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (ret == 0)
+            break;
+        num_bytes_done += ret;
+    }
+    num_bytes_written += num_bytes_done;
+    return num_bytes_done / sz;
+}
+
 bigint jfwrite(void* data, size_t sz, bigint num, FILE* F)
 {
     bigint ret = fwrite(data, sz, num, F);
@@ -21,6 +21,7 @@
 #include <QFile>
 #include <QTextStream>
 #include <QTime>
+#include <QElapsedTimer>
 #include <QThread>
 #include <QCoreApplication>
 #include <QUrl>
@@ -33,6 +34,7 @@
 #include <QProcess>
 #include <QJsonArray>
 #include <QSettings>
+#include <QHash>
 #include "mlnetwork.h"
 
 #define PRV_VERSION "0.11"
@@ -259,6 +261,8 @@ void MLUtil::mkdirIfNeeded(const QString& path)
 }
 
 #include "sumit.h"
+#include "sumitindex.h"
+#include "prvlocalindex.h"
 QString MLUtil::computeSha1SumOfFile(const QString& path)
 {
     //printf("Looking up sha1: %s\n",path.toUtf8().data());
@@ -280,6 +284,30 @@ QString MLUtil::computeSha1SumOfFile(const QString& path)
     return ret;
     */
 }
+QStringList MLUtil::computeSha1SumOfFiles(const QStringList& paths)
+{
+    QStringList ret;
+    QStringList paths_to_sum;
+    QList<int> inds_to_sum;
+    for (int i = 0; i < paths.count(); i++) {
+        QString txt;
+        if (QFile::exists(paths[i] + ".sha1"))
+            txt = TextFile::read(paths[i] + ".sha1").trimmed();
+        if (txt.count() == 40) {
+            ret << txt;
+        }
+        else {
+            ret << "";
+            paths_to_sum << paths[i];
+            inds_to_sum << i;
+        }
+    }
+    QStringList sums = sumit_files(paths_to_sum, MLUtil::tempPath());
+    for (int j = 0; j < inds_to_sum.count(); j++) {
+        ret[inds_to_sum[j]] = sums[j];
+    }
+    return ret;
+}
 QString MLUtil::computeSha1SumOfFileHead(const QString& path, bigint num_bytes)
 {
     return sumit(path, num_bytes, MLUtil::tempPath());
@@ -290,6 +318,30 @@ QString MLUtil::computeSha1SumOfDirectory(const QString& path)
     return sumit_dir(path, MLUtil::tempPath());
 }
 
+void MLUtil::benchmarkSha1SumOfFile(const QString& path, int num_passes)
+{
+    bigint size = QFileInfo(path).size();
+    if (size <= 0) {
+        printf("Unable to benchmark hashing of empty or missing file: %s\n", path.toUtf8().data());
+        return;
+    }
+    printf("Hashing %s (%.3f GB). The first pass may read from disk, the others from the page cache.\n", path.toUtf8().data(), size * 1e-9);
+    for (int pass = 0; pass < num_passes; pass++) {
+        QElapsedTimer timer;
+        timer.start();
+        QString sha1 = compute_the_file_hash(path, 0);
+        double file_sec = timer.nsecsElapsed() * 1e-9;
+        timer.start();
+        QString tree_hash = compute_the_file_tree_hash(path);
+        double tree_sec = timer.nsecsElapsed() * 1e-9;
+        if ((sha1.isEmpty()) || (tree_hash.isEmpty())) {
+            printf("Problem reading file: %s\n", path.toUtf8().data());
+            return;
+        }
+        printf("pass %d: sha1 %.3f GB/s, tree hash %.3f GB/s (%d threads)\n", pass + 1, size * 1e-9 / file_sec, size * 1e-9 / tree_sec, QThread::idealThreadCount());
+    }
+}
+
 static QString s_temp_path = "";
 QString MLUtil::tempPath()
 {
@@ -412,133 +464,6 @@ QVariant clp_string_to_variant(const QString& str)
     return str;
 }
 
-double MLCompute::min(const QVector<double>& X)
-{
-    if (X.count() == 0)
-        return 0;
-    return *std::min_element(X.constBegin(), X.constEnd());
-}
-
-double MLCompute::max(const QVector<double>& X)
-{
-    if (X.count() == 0)
-        return 0;
-    return *std::max_element(X.constBegin(), X.constEnd());
-}
-
-double MLCompute::min(const MLVector<double>& X)
-{
-    if (X.count() == 0)
-        return 0;
-    return *std::min_element(X.begin(), X.end());
-}
-
-double MLCompute::max(const MLVector<double>& X)
-{
-    if (X.count() == 0)
-        return 0;
-    return *std::max_element(X.begin(), X.end());
-}
-
-int MLCompute::min(const MLVector<int>& X)
-{
-    if (X.count() == 0)
-        return 0;
-    return *std::min_element(X.begin(), X.end());
-}
-
-int MLCompute::max(const MLVector<int>& X)
-{
-    if (X.count() == 0)
-        return 0;
-    return *std::max_element(X.begin(), X.end());
-}
-
-double MLCompute::sum(const QVector<double>& X)
-{
-    return std::accumulate(X.constBegin(), X.constEnd(), 0.0);
-}
-
-double MLCompute::mean(const QVector<double>& X)
-{
-    if (X.isEmpty())
-        return 0;
-    double s = sum(X);
-    return s / X.count();
-}
-
-double MLCompute::stdev(const QVector<double>& X)
-{
-    double sumsqr = std::inner_product(X.constBegin(), X.constEnd(), X.constBegin(), 0.0);
-    double sum = std::accumulate(X.constBegin(), X.constEnd(), 0.0);
-    int ct = X.count();
-    if (ct >= 2) {
-        return sqrt((sumsqr - sum * sum / ct) / (ct - 1));
-    }
-    else
-        return 0;
-}
-
-double MLCompute::dotProduct(const QVector<double>& X1, const QVector<double>& X2)
-{
-    if (X1.count() != X2.count())
-        return 0;
-    return std::inner_product(X1.constBegin(), X1.constEnd(), X2.constBegin(), 0.0);
-}
-
-double MLCompute::norm(const QVector<double>& X)
-{
-    return sqrt(dotProduct(X, X));
-}
-
-double MLCompute::dotProduct(const QVector<float>& X1, const QVector<float>& X2)
-{
-    if (X1.count() != X2.count())
-        return 0;
-    return std::inner_product(X1.constBegin(), X1.constEnd(), X2.constBegin(), 0.0);
-}
-
-double MLCompute::norm(const QVector<float>& X)
-{
-    return sqrt(dotProduct(X, X));
-}
-
-double MLCompute::correlation(const QVector<double>& X1, const QVector<double>& X2)
-{
-    if (X1.count() != X2.count())
-        return 0;
-    int N = X1.count();
-    double mean1 = mean(X1);
-    double stdev1 = stdev(X1);
-    double mean2 = mean(X2);
-    double stdev2 = stdev(X2);
-    if ((stdev1 == 0) || (stdev2 == 0))
-        return 0;
-    QVector<double> Y1(N);
-    QVector<double> Y2(N);
-    for (bigint i = 0; i < N; i++) {
-        Y1[i] = (X1[i] - mean1) / stdev1;
-        Y2[i] = (X2[i] - mean2) / stdev2;
-    }
-    return dotProduct(Y1, Y2);
-}
-
-double MLCompute::norm(bigint N, const double* X)
-{
-    return sqrt(dotProduct(N, X, X));
-}
-
-double MLCompute::dotProduct(bigint N, const double* X1, const double* X2)
-{
-    return std::inner_product(X1, X1 + N, X2, 0.0);
-}
-
-double MLCompute::dotProduct(bigint N, const float* X1, const float* X2)
-{
-
-    return std::inner_product(X1, X1 + N, X2, 0.0);
-}
-
 QString MLUtil::computeSha1SumOfString(const QString& str)
 {
     QCryptographicHash hash(QCryptographicHash::Sha1);
@@ -546,28 +471,6 @@ QString MLUtil::computeSha1SumOfString(const QString& str)
     return QString(hash.result().toHex());
 }
 
-double MLCompute::sum(bigint N, const double* X)
-{
-    return std::accumulate(X, X + N, 0.0);
-}
-
-double MLCompute::mean(bigint N, const double* X)
-{
-    if (!N)
-        return 0;
-    return sum(N, X) / N;
-}
-
-double MLCompute::max(bigint N, const double* X)
-{
-    return N ? *std::max_element(X, X + N) : 0;
-}
-
-double MLCompute::min(bigint N, const double* X)
-{
-    return N ? *std::min_element(X, X + N) : 0;
-}
-
 QList<int> MLUtil::stringListToIntList(const QStringList& list)
 {
     QList<int> ret;
@@ -717,33 +620,6 @@ bool MLUtil::writeByteArray(const QString& path, const QByteArray& X)
     return true;
 }
 
-double MLCompute::min(bigint N, const float* X)
-{
-    return N ? *std::min_element(X, X + N) : 0;
-}
-
-double MLCompute::max(bigint N, const float* X)
-{
-    return N ? *std::max_element(X, X + N) : 0;
-}
-
-double MLCompute::sum(bigint N, const float* X)
-{
-    return std::accumulate(X, X + N, 0.0);
-}
-
-double MLCompute::mean(bigint N, const float* X)
-{
-    if (!N)
-        return 0;
-    return sum(N, X) / N;
-}
-
-double MLCompute::norm(bigint N, const float* X)
-{
-    return sqrt(dotProduct(N, X, X));
-}
-
 double MLCompute::median(const QVector<double>& X)
 {
     if (X.isEmpty())
@@ -1126,6 +1002,11 @@ QString locate_prv(const QJsonObject& obj)
     */
 }
 
+QStringList locate_prv_batch(const QList<QJsonObject>& objects)
+{
+    return MLUtil::locatePrvBatch(objects, get_local_search_paths());
+}
+
 QStringList MLUtil::toStringList(const QVariant& val)
 {
     QStringList ret;
@@ -1167,36 +1048,6 @@ bool MLUtil::matchesFastChecksum(QString path, QString fcs)
     }
 }
 
-double MLCompute::correlation(bigint N, const float* X1, const float* X2)
-{
-    if (N <= 1)
-        return 0;
-    double mean1 = mean(N, X1);
-    double stdev1 = stdev(N, X1);
-    double mean2 = mean(N, X2);
-    double stdev2 = stdev(N, X2);
-    if ((stdev1 == 0) || (stdev2 == 0))
-        return 0;
-    QVector<double> Y1(N);
-    QVector<double> Y2(N);
-    for (bigint i = 0; i < N; i++) {
-        Y1[i] = (X1[i] - mean1) / stdev1;
-        Y2[i] = (X2[i] - mean2) / stdev2;
-    }
-    return dotProduct(Y1, Y2) / (N - 1);
-}
-
-double MLCompute::stdev(bigint N, const float* X)
-{
-    double sumsqr = dotProduct(N, X, X);
-    double sum0 = sum(N, X);
-    if (N >= 2) {
-        return sqrt((sumsqr - sum0 * sum0 / N) / (N - 1));
-    }
-    else
-        return 0;
-}
-
 QJsonObject MLUtil::createPrvObject(const QString& file_or_dir_path)
 {
     qDebug().noquote() << "Creating prv object for: " + file_or_dir_path;
@@ -1244,17 +1095,15 @@ QJsonObject MLUtil::createPrvObject(const QString& file_or_dir_path)
     }
 }
 
-bool file_matches_prv_object(QString file_path, const QJsonObject& obj)
+//the size and fast checksum of the file match; the full checksum is left to the caller
+bool file_may_match_prv_object(QString file_path, const QJsonObject& obj)
 {
     if (QFile::exists(file_path)) {
         bigint original_size = obj["original_size"].toVariant().toLongLong();
         if (QFileInfo(file_path).size() == original_size) {
             QString fcs = obj["original_fcs"].toString();
             if (MLUtil::matchesFastChecksum(file_path, fcs)) {
-                QString checksum = obj["original_checksum"].toString();
-                if (MLUtil::computeSha1SumOfFile(file_path) == checksum) {
-                    return true;
-                }
+                return true;
             }
         }
     }
@@ -1297,13 +1146,19 @@ bool directory_matches_prv_object(QString dir_path, const QJsonObject& obj, bool
             return false;
     }
 
-    //check to see if file content matches
+    //check to see if file content matches, computing the checksums of all the files together
+    QStringList file_paths, checksums;
     for (int i = 0; i < files1.count(); i++) {
         QString fname0 = files1[i].toObject().value("name").toString();
-        if (!file_matches_prv_object(dir_path + "/" + fname0, files1[i].toObject().value("prv").toObject())) {
+        QJsonObject prv0 = files1[i].toObject().value("prv").toObject();
+        if (!file_may_match_prv_object(dir_path + "/" + fname0, prv0)) {
             return false;
         }
+        file_paths << dir_path + "/" + fname0;
+        checksums << prv0["original_checksum"].toString();
     }
+    if (MLUtil::computeSha1SumOfFiles(file_paths) != checksums)
+        return false;
 
     //check to see if dir content matches
     for (int i = 0; i < dirs1.count(); i++) {
@@ -1316,39 +1171,47 @@ bool directory_matches_prv_object(QString dir_path, const QJsonObject& obj, bool
     return true;
 }
 
-QString find_directory_2(const QJsonObject& obj, QString base_path, bool recursive, bool verbose)
+QString find_directory_in_search_paths(const QJsonObject& obj, const QStringList& local_search_paths)
 {
-    if (directory_matches_prv_object(base_path, obj, verbose))
-        return base_path;
-    if (recursive) {
-        QStringList dirs = QDir(base_path).entryList(QStringList("*"), QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
-        foreach (QString dir, dirs) {
-            QString path = base_path + "/" + dir;
-            QString path0 = find_directory_2(obj, path, recursive, verbose);
-            if (!path0.isEmpty())
-                return path0;
+    //first the directories of the indices with the same tree of names and file sizes
+    for (int i = 0; i < local_search_paths.count(); i++) {
+        QStringList candidates = PrvLocalIndex::instance(local_search_paths[i])->findDirectoryCandidates(obj);
+        foreach (QString candidate, candidates) {
+            if (directory_matches_prv_object(candidate, obj, false))
+                return candidate;
+        }
+    }
+    //files modified in place are not seen by the indices until they are stat'ed again, which may change the fingerprints of their directories
+    for (int i = 0; i < local_search_paths.count(); i++) {
+        PrvLocalIndex* index = PrvLocalIndex::instance(local_search_paths[i]);
+        if (!index->refreshFiles())
+            continue;
+        QStringList candidates = index->findDirectoryCandidates(obj);
+        foreach (QString candidate, candidates) {
+            if (directory_matches_prv_object(candidate, obj, false))
+                return candidate;
         }
     }
     return "";
 }
 
-QString find_directory_in_search_paths(const QJsonObject& obj, const QStringList& local_search_paths)
+//whether the index of the search path has already considered the file as it is now
+static bool is_indexed_as_is(const QHash<QString, QPair<qint64, qint64> >& stamps, const QString& name, const SumitFileKey& key)
 {
-    for (int i = 0; i < local_search_paths.count(); i++) {
-        QString search_path = local_search_paths[i];
-        QString fname = find_directory_2(obj, search_path, true, false);
-        if (!fname.isEmpty())
-            return fname;
-    }
-    return "";
+    auto it = stamps.constFind(name);
+    return ((it != stamps.constEnd()) && (it.value().first == (qint64)key.size) && (it.value().second == (qint64)key.mtime_ns));
 }
 
-QString find_file_2(QString directory, QString checksum, QString fcs_optional, bigint size, bool recursive, bool verbose)
+QString find_file_2(QString directory, QString checksum, QString fcs_optional, bigint size, bool recursive, bool verbose, PrvLocalIndex* index)
 {
+    QHash<QString, QPair<qint64, qint64> > stamps;
+    if (index)
+        stamps = index->fileStamps(directory);
     QStringList files = QDir(directory).entryList(QStringList("*"), QDir::Files, QDir::Name);
     foreach (QString file, files) {
         QString path = directory + "/" + file;
-        if (QFileInfo(path).size() == size) {
+        SumitFileKey key;
+        if ((SumitIndex::fileKey(path, &key)) && ((bigint)key.size == size) && (!is_indexed_as_is(stamps, file, key))) {
             if (!fcs_optional.isEmpty()) {
                 if (verbose)
                     printf("Fast checksum test for %s\n", path.toUtf8().data());
@@ -1384,7 +1247,7 @@ QString find_file_2(QString directory, QString checksum, QString fcs_optional, b
     if (recursive) {
         QStringList dirs = QDir(directory).entryList(QStringList("*"), QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
         foreach (QString dir, dirs) {
-            QString path = find_file_2(directory + "/" + dir, checksum, fcs_optional, size, recursive, verbose);
+            QString path = find_file_2(directory + "/" + dir, checksum, fcs_optional, size, recursive, verbose, index);
             if (!path.isEmpty())
                 return path;
         }
@@ -1394,17 +1257,123 @@ QString find_file_2(QString directory, QString checksum, QString fcs_optional, b
 
 QString find_local_file(bigint size, const QString& checksum, const QString& fcs_optional, const QStringList& local_search_paths, bool verbose)
 {
+    //first look in the indices of the search paths, which only need to list the directories that changed
+    for (int i = 0; i < local_search_paths.count(); i++) {
+        QString fname = PrvLocalIndex::instance(local_search_paths[i])->findFile(size, checksum, fcs_optional);
+        if (!fname.isEmpty())
+            return fname;
+    }
+    //files modified in place are not seen by the indices. Only those are checked, which costs a stat per file
     for (int i = 0; i < local_search_paths.count(); i++) {
         QString search_path = local_search_paths[i];
         if (verbose)
             qDebug().noquote() << "Searching: " + search_path;
-        QString fname = find_file_2(search_path, checksum, fcs_optional, size, true, verbose);
+        QString fname = find_file_2(search_path, checksum, fcs_optional, size, true, verbose, PrvLocalIndex::instance(search_path));
         if (!fname.isEmpty())
             return fname;
     }
     return "";
 }
 
+void find_files_2(QString directory, const QMultiHash<bigint, int>& requests, const QStringList& checksums, const QStringList& fcss, QStringList& paths, int* num_remaining, PrvLocalIndex* index)
+{
+    QHash<QString, QPair<qint64, qint64> > stamps;
+    if (index)
+        stamps = index->fileStamps(directory);
+    QStringList files = QDir(directory).entryList(QStringList("*"), QDir::Files, QDir::Name);
+    foreach (QString file, files) {
+        QString path = directory + "/" + file;
+        SumitFileKey key;
+        if ((!SumitIndex::fileKey(path, &key)) || (is_indexed_as_is(stamps, file, key)))
+            continue;
+        QList<int> inds = requests.values(key.size);
+        QString checksum1;
+        foreach (int i, inds) {
+            if (!paths[i].isEmpty())
+                continue;
+            if (!MLUtil::matchesFastChecksum(path, fcss[i]))
+                continue;
+            if (checksum1.isEmpty())
+                checksum1 = MLUtil::computeSha1SumOfFile(path);
+            if (checksum1 == checksums[i]) {
+                paths[i] = path;
+                (*num_remaining)--;
+            }
+        }
+        if (*num_remaining == 0)
+            return;
+    }
+    QStringList dirs = QDir(directory).entryList(QStringList("*"), QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    foreach (QString dir, dirs) {
+        find_files_2(directory + "/" + dir, requests, checksums, fcss, paths, num_remaining, index);
+        if (*num_remaining == 0)
+            return;
+    }
+}
+
+//find_local_file for several files, in a single traversal of the search paths
+QStringList find_local_files(const QList<bigint>& sizes, const QStringList& checksums, const QStringList& fcss, const QStringList& local_search_paths)
+{
+    QStringList paths;
+    QMultiHash<bigint, int> requests;
+    for (int i = 0; i < sizes.count(); i++) {
+        paths << "";
+        requests.insert(sizes[i], i);
+    }
+
+    //first look in the indices of the search paths, which only need to list the directories that changed
+    for (int j = 0; j < local_search_paths.count(); j++) {
+        QList<int> inds;
+        QList<qint64> sizes0;
+        QStringList checksums0, fcss0;
+        for (int i = 0; i < sizes.count(); i++) {
+            if (paths[i].isEmpty()) {
+                inds << i;
+                sizes0 << sizes[i];
+                checksums0 << checksums[i];
+                fcss0 << fcss[i];
+            }
+        }
+        if (inds.isEmpty())
+            return paths;
+        QStringList paths0 = PrvLocalIndex::instance(local_search_paths[j])->findFiles(sizes0, checksums0, fcss0);
+        for (int k = 0; k < inds.count(); k++) {
+            paths[inds[k]] = paths0[k];
+        }
+    }
+
+    //files modified in place are not seen by the indices. Only those are checked, which costs a stat per file
+    int num_remaining = 0;
+    for (int i = 0; i < sizes.count(); i++) {
+        if (paths[i].isEmpty())
+            num_remaining++;
+    }
+    for (int j = 0; (j < local_search_paths.count()) && (num_remaining > 0); j++) {
+        find_files_2(local_search_paths[j], requests, checksums, fcss, paths, &num_remaining, PrvLocalIndex::instance(local_search_paths[j]));
+    }
+    return paths;
+}
+
+bool prv_file_is_at_original_path(const QJsonObject& obj)
+{
+    bigint size = obj["original_size"].toVariant().toLongLong();
+    QString checksum = obj["original_checksum"].toString();
+    QString fcs = obj["original_fcs"].toString();
+    QString original_path = obj["original_path"].toString();
+    if (!original_path.isEmpty()) {
+        if (QFile::exists(original_path)) {
+            if (QFileInfo(original_path).size() == size) {
+                if (MLUtil::matchesFastChecksum(original_path, fcs)) {
+                    if (MLUtil::computeSha1SumOfFile(original_path) == checksum) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
 QString MLUtil::locatePrv(const QJsonObject& obj, const QStringList& local_search_paths)
 {
     if (obj.contains("original_checksum")) {
@@ -1412,18 +1381,8 @@ QString MLUtil::locatePrv(const QJsonObject& obj, const QStringList& local_searc
         bigint size = obj["original_size"].toVariant().toLongLong();
         QString checksum = obj["original_checksum"].toString();
         QString fcs = obj["original_fcs"].toString();
-        QString original_path = obj["original_path"].toString();
-        if (!original_path.isEmpty()) {
-            if (QFile::exists(original_path)) {
-                if (QFileInfo(original_path).size() == size) {
-                    if (matchesFastChecksum(original_path, fcs)) {
-                        if (MLUtil::computeSha1SumOfFile(original_path) == checksum) {
-                            return original_path;
-                        }
-                    }
-                }
-            }
-        }
+        if (prv_file_is_at_original_path(obj))
+            return obj["original_path"].toString();
         return find_local_file(size, checksum, fcs, local_search_paths, false);
     }
     else {
@@ -1438,3 +1397,35 @@ QString MLUtil::locatePrv(const QJsonObject& obj, const QStringList& local_searc
         return fname;
     }
 }
+
+QStringList MLUtil::locatePrvBatch(const QList<QJsonObject>& objects, const QStringList& local_search_paths)
+{
+    QStringList ret;
+    QList<int> inds;
+    QList<bigint> sizes;
+    QStringList checksums, fcss;
+    for (int i = 0; i < objects.count(); i++) {
+        const QJsonObject& obj = objects[i];
+        ret << "";
+        if (!obj.contains("original_checksum")) {
+            //it is a directory
+            ret[i] = MLUtil::locatePrv(obj, local_search_paths);
+        }
+        else if (prv_file_is_at_original_path(obj)) {
+            ret[i] = obj["original_path"].toString();
+        }
+        else {
+            inds << i;
+            sizes << obj["original_size"].toVariant().toLongLong();
+            checksums << obj["original_checksum"].toString();
+            fcss << obj["original_fcs"].toString();
+        }
+    }
+    if (!inds.isEmpty()) {
+        QStringList paths = find_local_files(sizes, checksums, fcss, local_search_paths);
+        for (int k = 0; k < inds.count(); k++) {
+            ret[inds[k]] = paths[k];
+        }
+    }
+    return ret;
+}
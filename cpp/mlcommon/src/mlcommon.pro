@@ -18,7 +18,7 @@ TEMPLATE = lib
 
 INCLUDEPATH += ../include
 VPATH += ../include
-HEADERS += mlcommon.h sumit.h \
+HEADERS += mlcommon.h sumit.h sumitindex.h prvlocalindex.h \
     ../include/mda/mda32.h \
     ../include/mda/diskreadmda32.h \
     ../include/mda/mda_p.h \
@@ -33,10 +33,11 @@ HEADERS += mlcommon.h sumit.h \
     ../include/mllog.h \
     ../include/tracing/tracing.h \
     ../include/mlvector.h \
-    ../include/get_sort_indices.h
+    ../include/get_sort_indices.h \
+    ../include/mlthreads.h
 
 SOURCES += \
-    mlcommon.cpp sumit.cpp \
+    mlcommon.cpp mlcompute.cpp sumit.cpp sumitindex.cpp prvlocalindex.cpp \
     mda/mda32.cpp \
     mda/diskreadmda32.cpp \
     objectregistry.cpp \
@@ -48,13 +49,14 @@ SOURCES += \
     mllog.cpp \
     tracing/tracing.cpp \
     mlvector.cpp \
-    get_sort_indices.cpp
+    get_sort_indices.cpp \
+    mlthreads.cpp
 
 INCLUDEPATH += ../include/mda
 VPATH += ../include/mda
 VPATH += mda
-HEADERS += diskreadmda.h diskwritemda.h mda.h mdaio.h remotereadmda.h usagetracking.h
-SOURCES += diskreadmda.cpp diskwritemda.cpp mda.cpp mdaio.cpp remotereadmda.cpp usagetracking.cpp
+HEADERS += diskreadmda.h diskwritemda.h mda.h mdabufferpool.h mdaio.h mdamemorybudget.h mdastats.h mdaview.h remotereadmda.h usagetracking.h
+SOURCES += diskreadmda.cpp diskwritemda.cpp mda.cpp mdabufferpool.cpp mdaio.cpp mdamemorybudget.cpp mdastats.cpp remotereadmda.cpp usagetracking.cpp
 
 INCLUDEPATH += ../include/cachemanager
 VPATH += ../include/cachemanager
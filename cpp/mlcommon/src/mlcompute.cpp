@@ -0,0 +1,748 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mlcommon.h"
+#include "mlthreads.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <atomic>
+#include <functional>
+#include <math.h>
+
+/*
+ * Reduction kernels behind the MLCompute functions. Each has a portable
+ * version with several independent accumulators, and an AVX2 version that
+ * is selected at runtime on processors that support it (so the library
+ * itself does not need to be compiled with -mavx2). Sums are always
+ * accumulated in double precision, also for float input.
+ *
+ * Arrays of at least parallelThreshold() entries are split into contiguous
+ * parts that are reduced on separate threads.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MLCOMPUTE_USE_AVX2
+#include <immintrin.h>
+#define MLCOMPUTE_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#define DEFAULT_PARALLEL_THRESHOLD (4 * 1024 * 1024)
+#define MIN_ENTRIES_PER_THREAD (512 * 1024)
+
+static std::atomic<bigint> s_parallel_threshold(DEFAULT_PARALLEL_THRESHOLD);
+
+namespace {
+
+//sums of (X-shift) and (X-shift)^2. The shift (the first entry) keeps the variance formula accurate when the mean is large compared to the spread
+struct Moments {
+    double s1 = 0, s11 = 0;
+    void add(const Moments& other)
+    {
+        s1 += other.s1;
+        s11 += other.s11;
+    }
+};
+
+//the same for two arrays, together with the sum of (X1-shift1)*(X2-shift2)
+struct CrossMoments {
+    double s1 = 0, s2 = 0, s11 = 0, s22 = 0, s12 = 0;
+    void add(const CrossMoments& other)
+    {
+        s1 += other.s1;
+        s2 += other.s2;
+        s11 += other.s11;
+        s22 += other.s22;
+        s12 += other.s12;
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// portable kernels
+
+template <typename T>
+double sum_scalar(bigint N, const T* X)
+{
+    double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    bigint i = 0;
+    for (; i + 4 <= N; i += 4) {
+        a0 += X[i];
+        a1 += X[i + 1];
+        a2 += X[i + 2];
+        a3 += X[i + 3];
+    }
+    for (; i < N; i++)
+        a0 += X[i];
+    return (a0 + a1) + (a2 + a3);
+}
+
+template <typename T>
+double dot_scalar(bigint N, const T* X1, const T* X2)
+{
+    double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    bigint i = 0;
+    for (; i + 4 <= N; i += 4) {
+        a0 += (double)X1[i] * X2[i];
+        a1 += (double)X1[i + 1] * X2[i + 1];
+        a2 += (double)X1[i + 2] * X2[i + 2];
+        a3 += (double)X1[i + 3] * X2[i + 3];
+    }
+    for (; i < N; i++)
+        a0 += (double)X1[i] * X2[i];
+    return (a0 + a1) + (a2 + a3);
+}
+
+template <typename T>
+Moments moments_scalar(bigint N, const T* X, double shift)
+{
+    Moments ret;
+    for (bigint i = 0; i < N; i++) {
+        double x = X[i] - shift;
+        ret.s1 += x;
+        ret.s11 += x * x;
+    }
+    return ret;
+}
+
+template <typename T>
+CrossMoments cross_moments_scalar(bigint N, const T* X1, const T* X2, double shift1, double shift2)
+{
+    CrossMoments ret;
+    for (bigint i = 0; i < N; i++) {
+        double x1 = X1[i] - shift1;
+        double x2 = X2[i] - shift2;
+        ret.s1 += x1;
+        ret.s2 += x2;
+        ret.s11 += x1 * x1;
+        ret.s22 += x2 * x2;
+        ret.s12 += x1 * x2;
+    }
+    return ret;
+}
+
+//written with comparisons so that NaN values are skipped
+template <typename T>
+inline void update_min_max(T val_min, T val_max, T& min0, T& max0)
+{
+    if (val_min < min0)
+        min0 = val_min;
+    if (val_max > max0)
+        max0 = val_max;
+}
+
+//N must be at least 1. NaN entries are skipped, except in the first position
+template <typename T>
+void min_max_scalar(bigint N, const T* X, T& min0, T& max0)
+{
+    T mn = X[0], mx = X[0];
+    for (bigint i = 1; i < N; i++)
+        update_min_max(X[i], X[i], mn, mx);
+    min0 = mn;
+    max0 = mx;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels
+
+#ifdef MLCOMPUTE_USE_AVX2
+
+bool cpu_has_avx2()
+{
+    static bool ret = __builtin_cpu_supports("avx2");
+    return ret;
+}
+
+//four consecutive entries, as doubles
+MLCOMPUTE_AVX2_TARGET inline __m256d load4(const double* X)
+{
+    return _mm256_loadu_pd(X);
+}
+
+MLCOMPUTE_AVX2_TARGET inline __m256d load4(const float* X)
+{
+    return _mm256_cvtps_pd(_mm_loadu_ps(X));
+}
+
+MLCOMPUTE_AVX2_TARGET inline double hsum(__m256d a)
+{
+    double tmp[4];
+    _mm256_storeu_pd(tmp, a);
+    return (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+}
+
+template <typename T>
+MLCOMPUTE_AVX2_TARGET double sum_avx2(bigint N, const T* X)
+{
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    bigint i = 0;
+    for (; i + 8 <= N; i += 8) {
+        a0 = _mm256_add_pd(a0, load4(X + i));
+        a1 = _mm256_add_pd(a1, load4(X + i + 4));
+    }
+    return hsum(_mm256_add_pd(a0, a1)) + sum_scalar(N - i, X + i);
+}
+
+template <typename T>
+MLCOMPUTE_AVX2_TARGET double dot_avx2(bigint N, const T* X1, const T* X2)
+{
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    bigint i = 0;
+    for (; i + 8 <= N; i += 8) {
+        a0 = _mm256_add_pd(a0, _mm256_mul_pd(load4(X1 + i), load4(X2 + i)));
+        a1 = _mm256_add_pd(a1, _mm256_mul_pd(load4(X1 + i + 4), load4(X2 + i + 4)));
+    }
+    return hsum(_mm256_add_pd(a0, a1)) + dot_scalar(N - i, X1 + i, X2 + i);
+}
+
+template <typename T>
+MLCOMPUTE_AVX2_TARGET Moments moments_avx2(bigint N, const T* X, double shift)
+{
+    __m256d sh = _mm256_set1_pd(shift);
+    __m256d a1 = _mm256_setzero_pd(), a11 = _mm256_setzero_pd();
+    bigint i = 0;
+    for (; i + 4 <= N; i += 4) {
+        __m256d x = _mm256_sub_pd(load4(X + i), sh);
+        a1 = _mm256_add_pd(a1, x);
+        a11 = _mm256_add_pd(a11, _mm256_mul_pd(x, x));
+    }
+    Moments ret = moments_scalar(N - i, X + i, shift);
+    ret.s1 += hsum(a1);
+    ret.s11 += hsum(a11);
+    return ret;
+}
+
+template <typename T>
+MLCOMPUTE_AVX2_TARGET CrossMoments cross_moments_avx2(bigint N, const T* X1, const T* X2, double shift1, double shift2)
+{
+    __m256d sh1 = _mm256_set1_pd(shift1), sh2 = _mm256_set1_pd(shift2);
+    __m256d a1 = _mm256_setzero_pd(), a2 = _mm256_setzero_pd();
+    __m256d a11 = _mm256_setzero_pd(), a22 = _mm256_setzero_pd(), a12 = _mm256_setzero_pd();
+    bigint i = 0;
+    for (; i + 4 <= N; i += 4) {
+        __m256d x1 = _mm256_sub_pd(load4(X1 + i), sh1);
+        __m256d x2 = _mm256_sub_pd(load4(X2 + i), sh2);
+        a1 = _mm256_add_pd(a1, x1);
+        a2 = _mm256_add_pd(a2, x2);
+        a11 = _mm256_add_pd(a11, _mm256_mul_pd(x1, x1));
+        a22 = _mm256_add_pd(a22, _mm256_mul_pd(x2, x2));
+        a12 = _mm256_add_pd(a12, _mm256_mul_pd(x1, x2));
+    }
+    CrossMoments ret = cross_moments_scalar(N - i, X1 + i, X2 + i, shift1, shift2);
+    ret.s1 += hsum(a1);
+    ret.s2 += hsum(a2);
+    ret.s11 += hsum(a11);
+    ret.s22 += hsum(a22);
+    ret.s12 += hsum(a12);
+    return ret;
+}
+
+//min/max stay in the native type. The new entry goes first in _mm256_min_*, which then returns the second operand for NaN entries, so that they are skipped as in the scalar version
+MLCOMPUTE_AVX2_TARGET void min_max_avx2(bigint N, const double* X, double& min0, double& max0)
+{
+    __m256d mn = _mm256_set1_pd(X[0]), mx = mn;
+    bigint i = 0;
+    for (; i + 4 <= N; i += 4) {
+        __m256d x = _mm256_loadu_pd(X + i);
+        mn = _mm256_min_pd(x, mn);
+        mx = _mm256_max_pd(x, mx);
+    }
+    double tmp_min[4], tmp_max[4];
+    _mm256_storeu_pd(tmp_min, mn);
+    _mm256_storeu_pd(tmp_max, mx);
+    min0 = max0 = X[0];
+    for (int k = 0; k < 4; k++)
+        update_min_max(tmp_min[k], tmp_max[k], min0, max0);
+    for (; i < N; i++)
+        update_min_max(X[i], X[i], min0, max0);
+}
+
+MLCOMPUTE_AVX2_TARGET void min_max_avx2(bigint N, const float* X, float& min0, float& max0)
+{
+    __m256 mn = _mm256_set1_ps(X[0]), mx = mn;
+    bigint i = 0;
+    for (; i + 8 <= N; i += 8) {
+        __m256 x = _mm256_loadu_ps(X + i);
+        mn = _mm256_min_ps(x, mn);
+        mx = _mm256_max_ps(x, mx);
+    }
+    float tmp_min[8], tmp_max[8];
+    _mm256_storeu_ps(tmp_min, mn);
+    _mm256_storeu_ps(tmp_max, mx);
+    min0 = max0 = X[0];
+    for (int k = 0; k < 8; k++)
+        update_min_max(tmp_min[k], tmp_max[k], min0, max0);
+    for (; i < N; i++)
+        update_min_max(X[i], X[i], min0, max0);
+}
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// dispatch
+
+template <typename T>
+double sum_kernel(bigint N, const T* X)
+{
+#ifdef MLCOMPUTE_USE_AVX2
+    if (cpu_has_avx2())
+        return sum_avx2(N, X);
+#endif
+    return sum_scalar(N, X);
+}
+
+template <typename T>
+double dot_kernel(bigint N, const T* X1, const T* X2)
+{
+#ifdef MLCOMPUTE_USE_AVX2
+    if (cpu_has_avx2())
+        return dot_avx2(N, X1, X2);
+#endif
+    return dot_scalar(N, X1, X2);
+}
+
+template <typename T>
+Moments moments_kernel(bigint N, const T* X, double shift)
+{
+#ifdef MLCOMPUTE_USE_AVX2
+    if (cpu_has_avx2())
+        return moments_avx2(N, X, shift);
+#endif
+    return moments_scalar(N, X, shift);
+}
+
+template <typename T>
+CrossMoments cross_moments_kernel(bigint N, const T* X1, const T* X2, double shift1, double shift2)
+{
+#ifdef MLCOMPUTE_USE_AVX2
+    if (cpu_has_avx2())
+        return cross_moments_avx2(N, X1, X2, shift1, shift2);
+#endif
+    return cross_moments_scalar(N, X1, X2, shift1, shift2);
+}
+
+template <typename T>
+void min_max_kernel(bigint N, const T* X, T& min0, T& max0)
+{
+#ifdef MLCOMPUTE_USE_AVX2
+    if (cpu_has_avx2()) {
+        min_max_avx2(N, X, min0, max0);
+        return;
+    }
+#endif
+    min_max_scalar(N, X, min0, max0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// parallel path
+
+int num_parts_for(bigint N)
+{
+    bigint threshold = s_parallel_threshold;
+    if ((threshold <= 0) || (N < threshold))
+        return 1;
+    bigint num = qMin((bigint)QThread::idealThreadCount(), N / MIN_ENTRIES_PER_THREAD);
+    return (int)qMax(num, (bigint)1);
+}
+
+//run fn(part, i0, n) on num_parts contiguous ranges covering 0..N-1, the first range in the calling thread
+void run_in_parts(bigint N, int num_parts, const std::function<void(int, bigint, bigint)>& fn)
+{
+    QList<std::function<void()> > tasks;
+    for (int p = 0; p < num_parts; p++) {
+        bigint i0 = N * p / num_parts;
+        bigint i1 = N * (p + 1) / num_parts;
+        tasks << [&fn, p, i0, i1]() { fn(p, i0, i1 - i0); };
+    }
+    run_in_threads(tasks);
+}
+
+template <typename T>
+double sum(bigint N, const T* X)
+{
+    int num_parts = num_parts_for(N);
+    if (num_parts == 1)
+        return sum_kernel(N, X);
+    QVector<double> partial(num_parts);
+    double* partial_ptr = partial.data();
+    run_in_parts(N, num_parts, [=](int p, bigint i0, bigint n) { partial_ptr[p] = sum_kernel(n, X + i0); });
+    return sum_scalar(num_parts, partial_ptr);
+}
+
+template <typename T>
+double dot(bigint N, const T* X1, const T* X2)
+{
+    int num_parts = num_parts_for(N);
+    if (num_parts == 1)
+        return dot_kernel(N, X1, X2);
+    QVector<double> partial(num_parts);
+    double* partial_ptr = partial.data();
+    run_in_parts(N, num_parts, [=](int p, bigint i0, bigint n) { partial_ptr[p] = dot_kernel(n, X1 + i0, X2 + i0); });
+    return sum_scalar(num_parts, partial_ptr);
+}
+
+template <typename T>
+Moments moments(bigint N, const T* X, double shift)
+{
+    int num_parts = num_parts_for(N);
+    if (num_parts == 1)
+        return moments_kernel(N, X, shift);
+    QVector<Moments> partial(num_parts);
+    Moments* partial_ptr = partial.data();
+    run_in_parts(N, num_parts, [=](int p, bigint i0, bigint n) { partial_ptr[p] = moments_kernel(n, X + i0, shift); });
+    Moments ret;
+    for (int p = 0; p < num_parts; p++)
+        ret.add(partial_ptr[p]);
+    return ret;
+}
+
+template <typename T>
+CrossMoments cross_moments(bigint N, const T* X1, const T* X2, double shift1, double shift2)
+{
+    int num_parts = num_parts_for(N);
+    if (num_parts == 1)
+        return cross_moments_kernel(N, X1, X2, shift1, shift2);
+    QVector<CrossMoments> partial(num_parts);
+    CrossMoments* partial_ptr = partial.data();
+    run_in_parts(N, num_parts, [=](int p, bigint i0, bigint n) { partial_ptr[p] = cross_moments_kernel(n, X1 + i0, X2 + i0, shift1, shift2); });
+    CrossMoments ret;
+    for (int p = 0; p < num_parts; p++)
+        ret.add(partial_ptr[p]);
+    return ret;
+}
+
+template <typename T>
+void min_max(bigint N, const T* X, double& min0, double& max0)
+{
+    if (N <= 0) {
+        min0 = max0 = 0;
+        return;
+    }
+    int num_parts = num_parts_for(N);
+    QVector<T> partial_min(num_parts), partial_max(num_parts);
+    T* min_ptr = partial_min.data();
+    T* max_ptr = partial_max.data();
+    if (num_parts == 1)
+        min_max_kernel(N, X, min_ptr[0], max_ptr[0]);
+    else
+        run_in_parts(N, num_parts, [=](int p, bigint i0, bigint n) { min_max_kernel(n, X + i0, min_ptr[p], max_ptr[p]); });
+    T mn = min_ptr[0], mx = max_ptr[0];
+    for (int p = 1; p < num_parts; p++)
+        update_min_max(min_ptr[p], max_ptr[p], mn, mx);
+    min0 = mn;
+    max0 = mx;
+}
+
+template <typename T>
+void mean_stdev(bigint N, const T* X, double& mean0, double& stdev0)
+{
+    if (N <= 0) {
+        mean0 = stdev0 = 0;
+        return;
+    }
+    double shift = X[0];
+    Moments M = moments(N, X, shift);
+    mean0 = shift + M.s1 / N;
+    if (N >= 2)
+        stdev0 = sqrt(qMax((M.s11 - M.s1 * M.s1 / N) / (N - 1), 0.0));
+    else
+        stdev0 = 0;
+}
+
+template <typename T>
+double correlation(bigint N, const T* X1, const T* X2)
+{
+    if (N <= 1)
+        return 0;
+    CrossMoments M = cross_moments(N, X1, X2, X1[0], X2[0]);
+    double var1 = M.s11 - M.s1 * M.s1 / N;
+    double var2 = M.s22 - M.s2 * M.s2 / N;
+    if ((var1 <= 0) || (var2 <= 0))
+        return 0;
+    return (M.s12 - M.s1 * M.s2 / N) / sqrt(var1 * var2);
+}
+
+//seconds per call of kernel, repeated for at least a quarter of a second
+double seconds_per_call(const std::function<void()>& kernel)
+{
+    QElapsedTimer timer;
+    timer.start();
+    bigint num_calls = 0;
+    do {
+        kernel();
+        num_calls++;
+    } while (timer.nsecsElapsed() < 250000000);
+    return timer.nsecsElapsed() * 1e-9 / num_calls;
+}
+
+template <typename T>
+void benchmark_reductions(bigint N, const char* type_name)
+{
+    MLVector<T> X1(N), X2(N);
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (bigint i = 0; i < N; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        X1[i] = (T)((double)(state >> 11) / (double)(1ull << 53));
+        X2[i] = (T)(1 - X1[i]);
+    }
+    volatile double sink = 0;
+    double a, b;
+    QList<QString> names;
+    QList<int> num_arrays;
+    QList<std::function<void()> > kernels;
+    names << "sum";
+    num_arrays << 1;
+    kernels << [&]() { sink = sum(N, X1.data()); };
+    names << "minMax";
+    num_arrays << 1;
+    kernels << [&]() { min_max(N, X1.data(), a, b); sink = a + b; };
+    names << "meanStdev";
+    num_arrays << 1;
+    kernels << [&]() { mean_stdev(N, X1.data(), a, b); sink = a + b; };
+    names << "dotProduct";
+    num_arrays << 2;
+    kernels << [&]() { sink = dot(N, X1.data(), X2.data()); };
+    names << "correlation";
+    num_arrays << 2;
+    kernels << [&]() { sink = correlation(N, X1.data(), X2.data()); };
+
+    bigint threshold = s_parallel_threshold;
+    for (int k = 0; k < kernels.count(); k++) {
+        double bytes = (double)N * sizeof(T) * num_arrays[k];
+        s_parallel_threshold = 0;
+        double serial_sec = seconds_per_call(kernels[k]);
+        s_parallel_threshold = 1;
+        double parallel_sec = seconds_per_call(kernels[k]);
+        printf("%-8s %-12s %10.2f %10.2f\n", type_name, names[k].toUtf8().data(), bytes * 1e-9 / serial_sec, bytes * 1e-9 / parallel_sec);
+    }
+    s_parallel_threshold = threshold;
+}
+
+} // namespace
+
+void MLCompute::benchmark(bigint num_entries)
+{
+    printf("MLCompute benchmark: %ld entries, %d threads\n", (long)num_entries, QThread::idealThreadCount());
+    printf("%-8s %-12s %10s %10s\n", "type", "kernel", "1 thread", "threads");
+    benchmark_reductions<double>(num_entries, "float64");
+    benchmark_reductions<float>(num_entries, "float32");
+    printf("(GB/s)\n");
+}
+
+void MLCompute::setParallelThreshold(bigint num_entries)
+{
+    s_parallel_threshold = num_entries;
+}
+
+bigint MLCompute::parallelThreshold()
+{
+    return s_parallel_threshold;
+}
+
+double MLCompute::min(const QVector<double>& X)
+{
+    return min(X.count(), X.constData());
+}
+
+double MLCompute::max(const QVector<double>& X)
+{
+    return max(X.count(), X.constData());
+}
+
+double MLCompute::min(const MLVector<double>& X)
+{
+    return min(X.count(), X.data());
+}
+
+double MLCompute::max(const MLVector<double>& X)
+{
+    return max(X.count(), X.data());
+}
+
+int MLCompute::min(const MLVector<int>& X)
+{
+    if (X.count() == 0)
+        return 0;
+    return *std::min_element(X.begin(), X.end());
+}
+
+int MLCompute::max(const MLVector<int>& X)
+{
+    if (X.count() == 0)
+        return 0;
+    return *std::max_element(X.begin(), X.end());
+}
+
+double MLCompute::sum(const QVector<double>& X)
+{
+    return sum(X.count(), X.constData());
+}
+
+double MLCompute::mean(const QVector<double>& X)
+{
+    return mean(X.count(), X.constData());
+}
+
+double MLCompute::stdev(const QVector<double>& X)
+{
+    return stdev(X.count(), X.constData());
+}
+
+double MLCompute::dotProduct(const QVector<double>& X1, const QVector<double>& X2)
+{
+    if (X1.count() != X2.count())
+        return 0;
+    return dotProduct(X1.count(), X1.constData(), X2.constData());
+}
+
+double MLCompute::norm(const QVector<double>& X)
+{
+    return norm(X.count(), X.constData());
+}
+
+double MLCompute::dotProduct(const QVector<float>& X1, const QVector<float>& X2)
+{
+    if (X1.count() != X2.count())
+        return 0;
+    return dotProduct(X1.count(), X1.constData(), X2.constData());
+}
+
+double MLCompute::norm(const QVector<float>& X)
+{
+    return norm(X.count(), X.constData());
+}
+
+double MLCompute::correlation(const QVector<double>& X1, const QVector<double>& X2)
+{
+    if (X1.count() != X2.count())
+        return 0;
+    //this overload has always returned the sum of the products of the z-scores, which is (N-1) times the correlation coefficient
+    bigint N = X1.count();
+    return correlation(N, X1.constData(), X2.constData()) * (N - 1);
+}
+
+double MLCompute::min(bigint N, const double* X)
+{
+    double mn, mx;
+    minMax(N, X, mn, mx);
+    return mn;
+}
+
+double MLCompute::max(bigint N, const double* X)
+{
+    double mn, mx;
+    minMax(N, X, mn, mx);
+    return mx;
+}
+
+double MLCompute::sum(bigint N, const double* X)
+{
+    return ::sum(N, X);
+}
+
+double MLCompute::mean(bigint N, const double* X)
+{
+    if (!N)
+        return 0;
+    return sum(N, X) / N;
+}
+
+double MLCompute::stdev(bigint N, const double* X)
+{
+    double m, s;
+    meanStdev(N, X, m, s);
+    return s;
+}
+
+double MLCompute::dotProduct(bigint N, const double* X1, const double* X2)
+{
+    return dot(N, X1, X2);
+}
+
+double MLCompute::correlation(bigint N, const double* X1, const double* X2)
+{
+    return ::correlation(N, X1, X2);
+}
+
+double MLCompute::norm(bigint N, const double* X)
+{
+    return sqrt(dotProduct(N, X, X));
+}
+
+void MLCompute::minMax(bigint N, const double* X, double& min, double& max)
+{
+    min_max(N, X, min, max);
+}
+
+void MLCompute::meanStdev(bigint N, const double* X, double& mean, double& stdev)
+{
+    mean_stdev(N, X, mean, stdev);
+}
+
+double MLCompute::min(bigint N, const float* X)
+{
+    double mn, mx;
+    minMax(N, X, mn, mx);
+    return mn;
+}
+
+double MLCompute::max(bigint N, const float* X)
+{
+    double mn, mx;
+    minMax(N, X, mn, mx);
+    return mx;
+}
+
+double MLCompute::sum(bigint N, const float* X)
+{
+    return ::sum(N, X);
+}
+
+double MLCompute::mean(bigint N, const float* X)
+{
+    if (!N)
+        return 0;
+    return sum(N, X) / N;
+}
+
+double MLCompute::stdev(bigint N, const float* X)
+{
+    double m, s;
+    meanStdev(N, X, m, s);
+    return s;
+}
+
+double MLCompute::dotProduct(bigint N, const float* X1, const float* X2)
+{
+    return dot(N, X1, X2);
+}
+
+double MLCompute::correlation(bigint N, const float* X1, const float* X2)
+{
+    return ::correlation(N, X1, X2);
+}
+
+double MLCompute::norm(bigint N, const float* X)
+{
+    return sqrt(dotProduct(N, X, X));
+}
+
+void MLCompute::minMax(bigint N, const float* X, double& min, double& max)
+{
+    min_max(N, X, min, max);
+}
+
+void MLCompute::meanStdev(bigint N, const float* X, double& mean, double& stdev)
+{
+    mean_stdev(N, X, mean, stdev);
+}
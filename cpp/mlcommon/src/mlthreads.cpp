@@ -0,0 +1,118 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mlthreads.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace {
+
+class MLTaskThread : public QThread {
+public:
+    std::function<void()> task;
+    void run()
+    {
+        task();
+    }
+};
+
+//the tasks of one run_in_threads() call. Shared with the queued runnables, which may outlive the call when the calling thread ran their task itself
+struct MLTaskGroup {
+    QList<std::function<void()> > tasks;
+    std::vector<std::atomic<int> > states; //0: not started, 1: running, 2: done
+    QMutex mutex;
+    QWaitCondition finished;
+
+    MLTaskGroup(const QList<std::function<void()> >& tasks0)
+        : tasks(tasks0)
+        , states(tasks0.count())
+    {
+        for (size_t i = 0; i < states.size(); i++)
+            states[i] = 0;
+    }
+    //run task i unless another thread has started it. Returns false if it had
+    bool run_task(int i)
+    {
+        int expected = 0;
+        if (!states[i].compare_exchange_strong(expected, 1))
+            return false;
+        tasks[i]();
+        QMutexLocker locker(&mutex);
+        states[i] = 2;
+        finished.wakeAll();
+        return true;
+    }
+};
+
+class MLTaskRunnable : public QRunnable {
+public:
+    std::shared_ptr<MLTaskGroup> group;
+    int index = 0;
+    void run()
+    {
+        group->run_task(index);
+    }
+};
+}
+
+void run_in_threads(const QList<std::function<void()> >& tasks, bool dedicated_threads)
+{
+    if (tasks.isEmpty())
+        return;
+    if (dedicated_threads) {
+        QList<MLTaskThread*> threads;
+        for (int i = 1; i < tasks.count(); i++) {
+            MLTaskThread* T = new MLTaskThread;
+            T->task = tasks[i];
+            T->start();
+            threads << T;
+        }
+        tasks[0]();
+        foreach (MLTaskThread* T, threads) {
+            T->wait();
+        }
+        qDeleteAll(threads);
+        return;
+    }
+    if (tasks.count() == 1) {
+        tasks[0]();
+        return;
+    }
+
+    std::shared_ptr<MLTaskGroup> group = std::make_shared<MLTaskGroup>(tasks);
+    for (int i = 1; i < tasks.count(); i++) {
+        MLTaskRunnable* R = new MLTaskRunnable; //deleted by the pool
+        R->group = group;
+        R->index = i;
+        QThreadPool::globalInstance()->start(R);
+    }
+    group->run_task(0);
+    //take over the tasks that are still queued, rather than wait for a pool thread that may be busy with the caller of this function
+    for (int i = 1; i < tasks.count(); i++)
+        group->run_task(i);
+    QMutexLocker locker(&group->mutex);
+    for (int i = 1; i < tasks.count(); i++) {
+        while (group->states[i] != 2)
+            group->finished.wait(&group->mutex);
+    }
+}
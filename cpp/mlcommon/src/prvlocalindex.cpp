@@ -0,0 +1,490 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "prvlocalindex.h"
+#include "sumitindex.h"
+#include "mlcommon.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QVariant>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QThread>
+
+#define PRV_LOCAL_INDEX_MAGIC 0x50525649 //PRVI
+#define PRV_LOCAL_INDEX_VERSION 1
+//a directory modified this recently may be modified again within the resolution of its timestamp, so it is listed again next time
+#define PRV_LOCAL_INDEX_UNSETTLED_NS (2 * 1000000000LL)
+
+namespace {
+
+struct IndexedFile {
+    QString name;
+    qint64 size = 0;
+    qint64 mtime_ns = 0;
+    QString sha1; //empty until computed
+};
+
+struct IndexedDirectory {
+    qint64 mtime_ns = -1; //-1: list again on the next update
+    QList<IndexedFile> files;
+    QStringList subdirs;
+};
+
+//the sha1 of the sorted lines "f <name> <size>" for the files and "d <name> <fingerprint>" for the subdirectories
+QByteArray directory_fingerprint(QStringList lines)
+{
+    lines.sort();
+    return QCryptographicHash::hash(lines.join("\n").toUtf8(), QCryptographicHash::Sha1);
+}
+
+QByteArray prv_object_fingerprint(const QJsonObject& obj)
+{
+    QStringList lines;
+    QJsonArray files = obj.value("files").toArray();
+    for (int i = 0; i < files.count(); i++) {
+        QJsonObject F = files[i].toObject();
+        lines << QString("f %1 %2").arg(F.value("name").toString()).arg(F.value("prv").toObject().value("original_size").toVariant().toLongLong());
+    }
+    QJsonArray dirs = obj.value("directories").toArray();
+    for (int i = 0; i < dirs.count(); i++) {
+        QJsonObject D = dirs[i].toObject();
+        lines << QString("d %1 %2").arg(D.value("name").toString()).arg(QString(prv_object_fingerprint(D.value("prv").toObject()).toHex()));
+    }
+    return directory_fingerprint(lines);
+}
+
+struct FileRef {
+    QString dir;
+    int index;
+};
+
+QDataStream& operator<<(QDataStream& out, const IndexedFile& F)
+{
+    return out << F.name << F.size << F.mtime_ns << F.sha1;
+}
+
+QDataStream& operator>>(QDataStream& in, IndexedFile& F)
+{
+    return in >> F.name >> F.size >> F.mtime_ns >> F.sha1;
+}
+
+QDataStream& operator<<(QDataStream& out, const IndexedDirectory& D)
+{
+    return out << D.mtime_ns << D.files << D.subdirs;
+}
+
+QDataStream& operator>>(QDataStream& in, IndexedDirectory& D)
+{
+    return in >> D.mtime_ns >> D.files >> D.subdirs;
+}
+}
+
+class PrvLocalIndexPrivate {
+public:
+    PrvLocalIndex* q;
+    QString search_path;
+    QString index_path;
+    QMap<QString, IndexedDirectory> dirs;
+    QMultiHash<qint64, FileRef> files_by_size;
+    QMultiHash<QString, FileRef> files_by_checksum;
+    QMultiHash<QByteArray, QString> dirs_by_fingerprint;
+    bool modified = false;
+    QMutex mutex;
+
+    void load();
+    void save();
+    void update();
+    void list_directory(const QString& path, IndexedDirectory* D, qint64 mtime_ns);
+    bool refresh_files();
+    void rebuild_lookup();
+    QString file_path(const FileRef& ref) const;
+    bool is_unchanged(const FileRef& ref, SumitFileKey* key);
+    void record_checksum(const FileRef& ref, const SumitFileKey& key, const QString& sha1);
+};
+
+PrvLocalIndex* PrvLocalIndex::instance(const QString& search_path)
+{
+    static QMutex s_mutex;
+    static QMap<QString, PrvLocalIndex*> s_instances;
+    QMutexLocker locker(&s_mutex);
+    if (!s_instances.contains(search_path))
+        s_instances[search_path] = new PrvLocalIndex(search_path);
+    return s_instances[search_path];
+}
+
+PrvLocalIndex::PrvLocalIndex(const QString& search_path)
+{
+    d = new PrvLocalIndexPrivate;
+    d->q = this;
+    d->search_path = search_path;
+    QString id = QString(QCryptographicHash::hash(search_path.toUtf8(), QCryptographicHash::Sha1).toHex());
+    d->index_path = MLUtil::tempPath() + "/prv_index/" + id + ".idx";
+    d->load();
+}
+
+PrvLocalIndex::~PrvLocalIndex()
+{
+    delete d;
+}
+
+void PrvLocalIndex::update()
+{
+    QMutexLocker locker(&d->mutex);
+    d->update();
+}
+
+QString PrvLocalIndex::findFile(qint64 size, const QString& checksum, const QString& fcs_optional)
+{
+    return findFiles(QList<qint64>() << size, QStringList(checksum), QStringList(fcs_optional)).value(0);
+}
+
+QStringList PrvLocalIndex::findFiles(const QList<qint64>& sizes, const QStringList& checksums, const QStringList& fcs_optional)
+{
+    QMutexLocker locker(&d->mutex);
+    d->update();
+    QStringList ret;
+    SumitFileKey key;
+
+    //files whose checksum is already known
+    for (int i = 0; i < sizes.count(); i++) {
+        ret << "";
+        QList<FileRef> known = d->files_by_checksum.values(checksums.value(i));
+        foreach (FileRef ref, known) {
+            if ((d->is_unchanged(ref, &key)) && ((qint64)key.size == sizes[i])) {
+                ret[i] = d->file_path(ref);
+                break;
+            }
+        }
+    }
+
+    //files of the requested sizes whose checksum has not been computed yet. They are hashed a few at a time (in parallel), skipping those that fail the fast checksum, until every request is resolved
+    int num_remaining = 0;
+    QList<FileRef> refs;
+    QList<int> ref_requests;
+    for (int i = 0; i < sizes.count(); i++) {
+        if (!ret[i].isEmpty())
+            continue;
+        num_remaining++;
+        QList<FileRef> refs0 = d->files_by_size.values(sizes[i]);
+        foreach (FileRef ref, refs0) {
+            if (!d->dirs[ref.dir].files[ref.index].sha1.isEmpty())
+                continue;
+            refs << ref;
+            ref_requests << i;
+        }
+    }
+    QSet<QString> hashed;
+    int batch_size = qMax(1, QThread::idealThreadCount());
+    int r = 0;
+    while ((num_remaining > 0) && (r < refs.count())) {
+        QList<FileRef> batch;
+        QList<SumitFileKey> batch_keys;
+        QStringList batch_paths;
+        while ((batch.count() < batch_size) && (r < refs.count())) {
+            FileRef ref = refs[r];
+            int i = ref_requests[r];
+            r++;
+            if (!ret[i].isEmpty())
+                continue;
+            QString path = d->file_path(ref);
+            if (hashed.contains(path))
+                continue;
+            if (!d->is_unchanged(ref, &key))
+                continue;
+            QString fcs = fcs_optional.value(i);
+            if ((!fcs.isEmpty()) && (!MLUtil::matchesFastChecksum(path, fcs)))
+                continue;
+            hashed.insert(path);
+            batch << ref;
+            batch_keys << key;
+            batch_paths << path;
+        }
+        QStringList batch_checksums = MLUtil::computeSha1SumOfFiles(batch_paths);
+        for (int j = 0; j < batch.count(); j++) {
+            SumitFileKey key_after;
+            if ((SumitIndex::fileKey(batch_paths[j], &key_after)) && (key_after == batch_keys[j]))
+                d->record_checksum(batch[j], batch_keys[j], batch_checksums[j]);
+            for (int i = 0; i < sizes.count(); i++) {
+                if ((ret[i].isEmpty()) && ((qint64)batch_keys[j].size == sizes[i]) && (batch_checksums[j] == checksums.value(i))) {
+                    ret[i] = batch_paths[j];
+                    num_remaining--;
+                }
+            }
+        }
+    }
+
+    if (d->modified)
+        d->save();
+    return ret;
+}
+
+QStringList PrvLocalIndex::filesWithSize(qint64 size)
+{
+    QMutexLocker locker(&d->mutex);
+    QStringList ret;
+    QList<FileRef> refs = d->files_by_size.values(size);
+    foreach (FileRef ref, refs) {
+        ret << d->file_path(ref);
+    }
+    return ret;
+}
+
+QHash<QString, QPair<qint64, qint64> > PrvLocalIndex::fileStamps(const QString& directory)
+{
+    QMutexLocker locker(&d->mutex);
+    QHash<QString, QPair<qint64, qint64> > ret;
+    auto it = d->dirs.constFind(directory);
+    if (it == d->dirs.constEnd())
+        return ret;
+    foreach (const IndexedFile& F, it.value().files) {
+        ret[F.name] = qMakePair(F.size, F.mtime_ns);
+    }
+    return ret;
+}
+
+QStringList PrvLocalIndex::findDirectoryCandidates(const QJsonObject& prv_object)
+{
+    QMutexLocker locker(&d->mutex);
+    d->update();
+    QStringList ret = d->dirs_by_fingerprint.values(prv_object_fingerprint(prv_object));
+    ret.sort();
+    return ret;
+}
+
+bool PrvLocalIndex::refreshFiles()
+{
+    QMutexLocker locker(&d->mutex);
+    d->update();
+    if (!d->refresh_files())
+        return false;
+    d->update();
+    d->rebuild_lookup();
+    d->modified = true;
+    d->save();
+    return true;
+}
+
+QStringList PrvLocalIndex::directories()
+{
+    QMutexLocker locker(&d->mutex);
+    return d->dirs.keys();
+}
+
+void PrvLocalIndexPrivate::load()
+{
+    QFile f(index_path);
+    if (!f.open(QFile::ReadOnly))
+        return;
+    QDataStream in(&f);
+    quint32 magic, version;
+    QString path0;
+    in >> magic >> version >> path0;
+    if ((magic != PRV_LOCAL_INDEX_MAGIC) || (version != PRV_LOCAL_INDEX_VERSION) || (path0 != search_path))
+        return;
+    QMap<QString, IndexedDirectory> dirs0;
+    in >> dirs0;
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "Ignoring corrupt prv index:" << index_path;
+        return;
+    }
+    dirs = dirs0;
+    rebuild_lookup();
+}
+
+void PrvLocalIndexPrivate::save()
+{
+    QDir().mkpath(QFileInfo(index_path).path());
+    QSaveFile f(index_path);
+    if (!f.open(QFile::WriteOnly)) {
+        qWarning() << "Unable to write prv index:" << index_path;
+        return;
+    }
+    QDataStream out(&f);
+    out << (quint32)PRV_LOCAL_INDEX_MAGIC << (quint32)PRV_LOCAL_INDEX_VERSION << search_path << dirs;
+    if (f.commit())
+        modified = false;
+}
+
+void PrvLocalIndexPrivate::update()
+{
+    //another process may have saved a more recent index; it is only used if we have nothing yet
+    if (dirs.isEmpty())
+        load();
+
+    QSet<QString> seen;
+    QStringList stack;
+    stack << search_path;
+    bool changed = false;
+    qint64 now_ns = QDateTime::currentMSecsSinceEpoch() * 1000000;
+    while (!stack.isEmpty()) {
+        QString path = stack.takeLast();
+        SumitFileKey key;
+        if (!SumitIndex::fileKey(path, &key))
+            continue;
+        if (seen.contains(path))
+            continue;
+        seen.insert(path);
+        IndexedDirectory& D = dirs[path];
+        if ((D.mtime_ns < 0) || (D.mtime_ns != (qint64)key.mtime_ns)) {
+            qint64 mtime_ns = key.mtime_ns;
+            if (now_ns - mtime_ns < PRV_LOCAL_INDEX_UNSETTLED_NS)
+                mtime_ns = -1;
+            list_directory(path, &D, mtime_ns);
+            changed = true;
+        }
+        for (int i = D.subdirs.count() - 1; i >= 0; i--) {
+            stack << path + "/" + D.subdirs[i];
+        }
+    }
+    QStringList paths = dirs.keys();
+    foreach (QString path, paths) {
+        if (!seen.contains(path)) {
+            dirs.remove(path);
+            changed = true;
+        }
+    }
+    if (changed) {
+        rebuild_lookup();
+        modified = true;
+        save();
+    }
+}
+
+void PrvLocalIndexPrivate::list_directory(const QString& path, IndexedDirectory* D, qint64 mtime_ns)
+{
+    //checksums of files that have not changed are kept
+    QHash<QString, IndexedFile> previous;
+    foreach (const IndexedFile& F, D->files) {
+        previous[F.name] = F;
+    }
+    D->mtime_ns = mtime_ns;
+    D->files.clear();
+    QStringList files = QDir(path).entryList(QStringList("*"), QDir::Files, QDir::Name);
+    foreach (QString file, files) {
+        SumitFileKey key;
+        if (!SumitIndex::fileKey(path + "/" + file, &key))
+            continue;
+        IndexedFile F;
+        F.name = file;
+        F.size = key.size;
+        F.mtime_ns = key.mtime_ns;
+        if (previous.contains(file)) {
+            const IndexedFile& F0 = previous[file];
+            if ((F0.size == F.size) && (F0.mtime_ns == F.mtime_ns))
+                F.sha1 = F0.sha1;
+        }
+        D->files << F;
+    }
+    D->subdirs = QDir(path).entryList(QStringList("*"), QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+}
+
+bool PrvLocalIndexPrivate::refresh_files()
+{
+    bool changed = false;
+    for (auto it = dirs.begin(); it != dirs.end(); ++it) {
+        QList<IndexedFile>& files = it.value().files;
+        for (int i = 0; i < files.count(); i++) {
+            IndexedFile& F = files[i];
+            SumitFileKey key;
+            if (!SumitIndex::fileKey(it.key() + "/" + F.name, &key)) {
+                //removed: the directory is listed again by update()
+                it.value().mtime_ns = -1;
+                changed = true;
+                continue;
+            }
+            if (((qint64)key.size != F.size) || ((qint64)key.mtime_ns != F.mtime_ns)) {
+                F.size = key.size;
+                F.mtime_ns = key.mtime_ns;
+                F.sha1.clear();
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+void PrvLocalIndexPrivate::rebuild_lookup()
+{
+    files_by_size.clear();
+    files_by_checksum.clear();
+    dirs_by_fingerprint.clear();
+
+    //in reverse order, every directory comes after its subdirectories (whose paths it prefixes)
+    QHash<QString, QByteArray> fingerprints;
+    QStringList paths = dirs.keys();
+    for (int i = paths.count() - 1; i >= 0; i--) {
+        const IndexedDirectory& D = dirs[paths[i]];
+        QStringList lines;
+        foreach (const IndexedFile& F, D.files) {
+            lines << QString("f %1 %2").arg(F.name).arg(F.size);
+        }
+        foreach (const QString& subdir, D.subdirs) {
+            lines << QString("d %1 %2").arg(subdir).arg(QString(fingerprints.value(paths[i] + "/" + subdir).toHex()));
+        }
+        QByteArray fingerprint = directory_fingerprint(lines);
+        fingerprints[paths[i]] = fingerprint;
+        dirs_by_fingerprint.insert(fingerprint, paths[i]);
+    }
+
+    for (auto it = dirs.constBegin(); it != dirs.constEnd(); ++it) {
+        const QList<IndexedFile>& files = it.value().files;
+        for (int i = 0; i < files.count(); i++) {
+            FileRef ref;
+            ref.dir = it.key();
+            ref.index = i;
+            files_by_size.insert(files[i].size, ref);
+            if (!files[i].sha1.isEmpty())
+                files_by_checksum.insert(files[i].sha1, ref);
+        }
+    }
+}
+
+QString PrvLocalIndexPrivate::file_path(const FileRef& ref) const
+{
+    return ref.dir + "/" + dirs[ref.dir].files[ref.index].name;
+}
+
+bool PrvLocalIndexPrivate::is_unchanged(const FileRef& ref, SumitFileKey* key)
+{
+    const IndexedFile& F = dirs[ref.dir].files[ref.index];
+    if (!SumitIndex::fileKey(file_path(ref), key))
+        return false;
+    return (((qint64)key->size == F.size) && ((qint64)key->mtime_ns == F.mtime_ns));
+}
+
+void PrvLocalIndexPrivate::record_checksum(const FileRef& ref, const SumitFileKey& key, const QString& sha1)
+{
+    if (sha1.count() != 40)
+        return;
+    IndexedFile& F = dirs[ref.dir].files[ref.index];
+    if (((qint64)key.size != F.size) || ((qint64)key.mtime_ns != F.mtime_ns))
+        return;
+    F.sha1 = sha1;
+    files_by_checksum.insert(sha1, ref);
+    modified = true;
+}
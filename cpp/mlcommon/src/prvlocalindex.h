@@ -0,0 +1,64 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PRVLOCALINDEX_H
+#define PRVLOCALINDEX_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+/*
+An index of the files below one local search path, used by MLUtil::locatePrv before falling back to a recursive scan.
+
+For every directory the index keeps its modification time and its listing: the subdirectories, and the size, modification time and (once computed) sha1 of every file. update() stats each directory and lists again only those whose modification time changed, so keeping the index current costs one stat per directory rather than a listing and a stat per file. Files are then found by checksum, or by size and then fast/full checksum, through hash tables. Directories are found through a fingerprint of their tree of names and file sizes, which is recomputed bottom up whenever the index changes.
+
+The index is saved in <temporary_path>/prv_index/, one file per search path, and shared by all processes (each save atomically replaces the file). A file modified in place without changing its directory is not seen by the size lookup, which is why callers still scan when the index finds nothing. That scan uses fileStamps() to skip the files the index has already considered.
+*/
+
+class PrvLocalIndexPrivate;
+class PrvLocalIndex {
+public:
+    friend class PrvLocalIndexPrivate;
+    ///The index of search_path, loaded on first use and shared by the threads of the process
+    static PrvLocalIndex* instance(const QString& search_path);
+
+    ///Bring the index up to date with the directory tree, and save it if anything changed
+    void update();
+    ///The path of a file with the given size and checksum (and fast checksum, if not empty), or an empty string. Calls update() first
+    QString findFile(qint64 size, const QString& checksum, const QString& fcs_optional);
+    ///findFile() for several files at once, with a single update(). Candidate files are hashed a few at a time in parallel, stopping as soon as every file is found
+    QStringList findFiles(const QList<qint64>& sizes, const QStringList& checksums, const QStringList& fcs_optional);
+    ///The paths of all indexed files with the given size, as of the last update()
+    QStringList filesWithSize(qint64 size);
+    ///The size and modification time (in ns) of every file of directory, by file name, as of the last update(). A file that still has these has already been considered by findFile()
+    QHash<QString, QPair<qint64, qint64> > fileStamps(const QString& directory);
+    ///All indexed directories, including the search path itself, as of the last update()
+    QStringList directories();
+    ///The directories whose files and subdirectories, recursively, have the names (and the files the sizes) of those in the prv object of a directory. Calls update() first.
+    ///The checksums of the files are not compared
+    QStringList findDirectoryCandidates(const QJsonObject& prv_object);
+    ///Stat every indexed file again, so that files modified in place (which leave the modification time of their directory alone) get their new size and lose their checksum. Returns whether any file had changed
+    bool refreshFiles();
+
+private:
+    PrvLocalIndex(const QString& search_path);
+    ~PrvLocalIndex();
+    PrvLocalIndexPrivate* d;
+};
+
+#endif // PRVLOCALINDEX_H
@@ -15,6 +15,8 @@
  */
 
 #include "sumit.h"
+#include "sumitindex.h"
+#include "mlthreads.h"
 
 #include <QDebug>
 #include <QFile>
@@ -24,73 +26,182 @@
 #include <QStringList>
 #include <QTime>
 #include <QDataStream>
+#include <QHash>
+#include <QMap>
+#include <QSemaphore>
+#include <QThread>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <functional>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "mdabufferpool.h"
 
-QString compute_the_file_hash(const QString& path, int num_bytes)
+#define SUMIT_READ_BLOCK_SIZE (8 * 1024 * 1024)
+#define SUMIT_NUM_READ_BLOCKS 4
+#define SUMIT_TREE_BLOCK_SIZE (4 * 1024 * 1024)
+
+namespace {
+
+//read up to num_bytes at offset (or at the current position if offset is negative), returning fewer only at the end of the file, or -1 on error
+qint64 read_fully(int fd, char* data, qint64 num_bytes, qint64 offset = -1)
 {
-    // Do not printf here!
-    QCryptographicHash hash(QCryptographicHash::Sha1);
-    QFile FF(path);
-    if (!FF.open(QFile::ReadOnly))
-        return "";
-    int num_bytes_processed = 0;
-    while ((!FF.atEnd()) && ((num_bytes == 0) || (num_bytes_processed < num_bytes))) {
-        QByteArray tmp = FF.read(10000);
-        if (num_bytes != 0) {
-            if (num_bytes_processed + tmp.count() > num_bytes) {
-                tmp = tmp.mid(0, num_bytes - num_bytes_processed);
-            }
+    qint64 total = 0;
+    while (total < num_bytes) {
+        ssize_t num;
+        if (offset >= 0)
+            num = pread(fd, data + total, num_bytes - total, offset + total);
+        else
+            num = ::read(fd, data + total, num_bytes - total);
+        if (num < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
         }
-        hash.addData(tmp);
-        num_bytes_processed += tmp.count();
+        if (num == 0)
+            break;
+        total += num;
     }
-
-    QString ret = QString(hash.result().toHex());
-    return ret;
+    return total;
 }
 
-QString compute_the_string_hash(const QString& str)
+int open_for_hashing(const QString& path)
 {
-    QCryptographicHash X(QCryptographicHash::Sha1);
-    X.addData(str.toLatin1());
-    return QString(X.result().toHex());
+    int fd = ::open(path.toUtf8().data(), O_RDONLY | O_CLOEXEC);
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (fd >= 0)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return fd;
+}
 }
 
-void create_directory_if_doesnt_exist(const QString& dirname)
+QString compute_the_file_hash(const QString& path, qint64 num_bytes)
 {
-    QString parent_dirname = QFileInfo(dirname).path();
-    QString folder_name = QFileInfo(dirname).fileName();
-    if (QDir(parent_dirname).exists(folder_name))
-        return;
-
-    if (!parent_dirname.isEmpty()) {
-        create_directory_if_doesnt_exist(parent_dirname);
+    // Do not printf here!
+    int fd = open_for_hashing(path);
+    if (fd < 0)
+        return "";
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    struct stat SS;
+    qint64 size = (fstat(fd, &SS) == 0) ? (qint64)SS.st_size : -1;
+    if (num_bytes != 0) {
+        if ((size < 0) || (num_bytes < size))
+            size = num_bytes;
+    }
+    if ((size >= 0) && (size <= SUMIT_READ_BLOCK_SIZE)) {
+        //small files and heads are read at once in this thread
+        MdaPooledBuffer buf(qMax(size, (qint64)1));
+        qint64 num = read_fully(fd, buf.data(), size);
+        ::close(fd);
+        if (num < 0)
+            return "";
+        hash.addData(buf.data(), num);
+        return QString(hash.result().toHex());
     }
-    QDir(parent_dirname).mkdir(folder_name);
-}
 
-inline QString read_text_file(const QString& path)
-{
-    QFile f(path);
-    if (!f.open(QFile::ReadOnly | QFile::Text))
+    //the blocks are read on a separate thread into a ring of buffers, so that reading overlaps with hashing
+    MdaPooledBuffer buffers[SUMIT_NUM_READ_BLOCKS];
+    for (int i = 0; i < SUMIT_NUM_READ_BLOCKS; i++)
+        buffers[i].resize(SUMIT_READ_BLOCK_SIZE);
+    qint64 block_sizes[SUMIT_NUM_READ_BLOCKS];
+    QSemaphore free_blocks(SUMIT_NUM_READ_BLOCKS);
+    QSemaphore full_blocks(0);
+    auto read_blocks = [&]() {
+        qint64 remaining = num_bytes;
+        for (int i = 0;; i++) {
+            int b = i % SUMIT_NUM_READ_BLOCKS;
+            free_blocks.acquire();
+            qint64 num = SUMIT_READ_BLOCK_SIZE;
+            if ((num_bytes != 0) && (remaining < num))
+                num = remaining;
+            num = read_fully(fd, buffers[b].data(), num);
+            block_sizes[b] = num;
+            if (num > 0)
+                remaining -= num;
+            full_blocks.release();
+            if (num < SUMIT_READ_BLOCK_SIZE) //end of data, or error (-1)
+                break;
+        }
+    };
+    bool ok = true;
+    auto hash_blocks = [&]() {
+        for (int i = 0;; i++) {
+            int b = i % SUMIT_NUM_READ_BLOCKS;
+            full_blocks.acquire();
+            qint64 num = block_sizes[b];
+            if (num > 0)
+                hash.addData(buffers[b].data(), num);
+            free_blocks.release();
+            if (num < SUMIT_READ_BLOCK_SIZE) {
+                ok = (num >= 0);
+                break;
+            }
+        }
+    };
+    //the reader waits for the hashing, so it needs a thread of its own
+    run_in_threads(QList<std::function<void()> >() << hash_blocks << read_blocks, true);
+    ::close(fd);
+    if (!ok)
         return "";
-    QTextStream in(&f);
-    return in.readAll();
+    return QString(hash.result().toHex());
 }
-inline void write_text_file(const QString& path, const QString& txt)
+
+QString compute_the_file_tree_hash(const QString& path, qint64 block_size, int num_threads)
 {
-    QDir().mkpath(QFileInfo(path).dir().absolutePath());
-    QFile f(path);
-    if (!f.open(QFile::WriteOnly | QFile::Text))
-        return;
-    QTextStream out(&f);
-    out << txt;
+    int fd = open_for_hashing(path);
+    if (fd < 0)
+        return "";
+    struct stat SS;
+    if (fstat(fd, &SS) != 0) {
+        ::close(fd);
+        return "";
+    }
+    if (block_size <= 0)
+        block_size = SUMIT_TREE_BLOCK_SIZE;
+    qint64 size = SS.st_size;
+    qint64 num_blocks = qMax((qint64)1, (size + block_size - 1) / block_size);
+    if (num_threads <= 0)
+        num_threads = QThread::idealThreadCount();
+    num_threads = (int)qMax((qint64)1, qMin((qint64)num_threads, num_blocks));
+
+    //each thread takes the next block to be hashed until there are none left
+    std::vector<QByteArray> digests(num_blocks);
+    std::atomic<qint64> next_block(0);
+    std::atomic<bool> ok(true);
+    auto hash_blocks = [&]() {
+        MdaPooledBuffer buf(block_size);
+        for (qint64 b = next_block++; b < num_blocks; b = next_block++) {
+            qint64 offset = b * block_size;
+            qint64 num = read_fully(fd, buf.data(), qMin(block_size, size - offset), offset);
+            if (num < 0) {
+                ok = false;
+                return;
+            }
+            digests[b] = QCryptographicHash::hash(QByteArray::fromRawData(buf.data(), num), QCryptographicHash::Sha1);
+        }
+    };
+    QList<std::function<void()> > tasks;
+    for (int i = 0; i < num_threads; i++)
+        tasks << hash_blocks;
+    run_in_threads(tasks);
+    ::close(fd);
+    if (!ok)
+        return "";
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (qint64 b = 0; b < num_blocks; b++)
+        hash.addData(digests[b]);
+    return QString(hash.result().toHex());
 }
 
-void create_hash_file(const QString& path, const QString& hash_path)
+QString compute_the_string_hash(const QString& str)
 {
-    QString the_hash = compute_the_file_hash(path, 0);
-    write_text_file(hash_path, the_hash);
+    QCryptographicHash X(QCryptographicHash::Sha1);
+    X.addData(str.toLatin1());
+    return QString(X.result().toHex());
 }
 
 QString sumit(const QString& path, int num_bytes, const QString& temporary_path)
@@ -98,47 +209,105 @@ QString sumit(const QString& path, int num_bytes, const QString& temporary_path)
     if (num_bytes != 0) {
         return compute_the_file_hash(path, num_bytes);
     }
-    //the file id is a hashed function of device,inode,size, and modification time (in seconds)
+    return sumit_files(QStringList(path), temporary_path).value(0);
+}
+
+QStringList sumit_files(const QStringList& paths, const QString& temporary_path)
+{
+    //the file id is made of device, inode, size, and modification time
     //note that it is not dependent on the file name
-    struct stat SS;
-    stat(path.toLatin1().data(), &SS);
+    SumitIndex* index = SumitIndex::instance(temporary_path);
+    QList<SumitFileKey> keys;
+    QList<bool> exists;
+    for (int i = 0; i < paths.count(); i++) {
+        SumitFileKey key;
+        exists << SumitIndex::fileKey(paths[i], &key);
+        keys << key;
+    }
+    QStringList ret = index->lookup(keys);
+    QList<int> missing;
+    for (int i = 0; i < paths.count(); i++) {
+        if (!exists[i])
+            ret[i] = "";
+        else if (ret[i].count() != 40)
+            missing << i;
+    }
 
-    //didn't compile on mac so using the following which only depends on size and modification date
+    //the files that are not in the index are hashed in parallel, each thread taking the next file
+    std::vector<QString> sums(missing.count());
+    std::atomic<int> next_file(0);
+    auto hash_files = [&]() {
+        for (int j = next_file++; j < missing.count(); j = next_file++) {
+            sums[j] = compute_the_file_hash(paths[missing[j]], 0);
+        }
+    };
+    int num_threads = qMin(QThread::idealThreadCount(), missing.count());
+    QList<std::function<void()> > tasks;
+    for (int i = 0; i < num_threads; i++)
+        tasks << hash_files;
+    run_in_threads(tasks);
 
-    QFileInfo info(path);
-    QString id_string = QString("%1:%2:%3:%4").arg(path).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch()).arg(info.size());
+    QList<SumitFileKey> new_keys;
+    QStringList new_sums;
+    for (int j = 0; j < missing.count(); j++) {
+        int i = missing[j];
+        ret[i] = sums[j];
+        SumitFileKey key;
+        //do not record the checksum if the file changed while we were reading it
+        if ((ret[i].count() == 40) && (SumitIndex::fileKey(paths[i], &key)) && (key == keys[i])) {
+            new_keys << key;
+            new_sums << ret[i];
+        }
+    }
+    index->insert(new_keys, new_sums);
+    return ret;
+}
 
-    //QString id_string = QString("%1:%2:%3:%4").arg(SS.st_dev).arg(SS.st_ino).arg(SS.st_size).arg(SS.st_mtim.tv_sec);
-    QString file_id = compute_the_string_hash(id_string);
+namespace {
 
-    QString dirname = QString(temporary_path + "/sumit/sha1/%1").arg(file_id.mid(0, 4));
-    create_directory_if_doesnt_exist(dirname);
-    QString hash_path = QString("%1/%2").arg(dirname).arg(file_id);
+struct SumitDirListing {
+    QStringList files;
+    QStringList dirs;
+};
 
-    QString hash_sum = read_text_file(hash_path);
-    if (hash_sum.isEmpty()) {
-        create_hash_file(path, hash_path);
-        hash_sum = read_text_file(hash_path);
+void list_directory_tree(const QString& path, QMap<QString, SumitDirListing>& listings, QStringList& all_files)
+{
+    SumitDirListing& L = listings[path];
+    L.files = QDir(path).entryList(QStringList("*"), QDir::Files, QDir::Name);
+    L.dirs = QDir(path).entryList(QStringList("*"), QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (int i = 0; i < L.files.count(); i++) {
+        all_files << path + "/" + L.files[i];
     }
-    if (hash_sum.count() != 40) {
-        create_hash_file(path, hash_path);
-        hash_sum = read_text_file(hash_path);
+    QStringList dirs = L.dirs;
+    for (int i = 0; i < dirs.count(); i++) {
+        list_directory_tree(path + "/" + dirs[i], listings, all_files);
     }
-    return hash_sum;
 }
 
-QString sumit_dir(const QString& path, const QString& temporary_path)
+QString directory_tree_hash(const QString& path, const QMap<QString, SumitDirListing>& listings, const QHash<QString, QString>& file_sums)
 {
-    QStringList files = QDir(path).entryList(QStringList("*"), QDir::Files, QDir::Name);
-    QStringList dirs = QDir(path).entryList(QStringList("*"), QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
-
+    const SumitDirListing& L = listings[path];
     QString str = "";
-    for (int i = 0; i < dirs.count(); i++) {
-        str += QString("%1 %2\n").arg(sumit_dir(path + "/" + dirs[i], temporary_path)).arg(dirs[i]);
+    for (int i = 0; i < L.dirs.count(); i++) {
+        str += QString("%1 %2\n").arg(directory_tree_hash(path + "/" + L.dirs[i], listings, file_sums)).arg(L.dirs[i]);
     }
-    for (int i = 0; i < files.count(); i++) {
-        str += QString("%1 %2\n").arg(sumit(path + "/" + files[i], 0, temporary_path)).arg(files[i]);
+    for (int i = 0; i < L.files.count(); i++) {
+        str += QString("%1 %2\n").arg(file_sums.value(path + "/" + L.files[i])).arg(L.files[i]);
     }
-
     return compute_the_string_hash(str);
 }
+}
+
+QString sumit_dir(const QString& path, const QString& temporary_path)
+{
+    //the whole tree is listed first so that all of its files are looked up and hashed (in parallel) together; the directory hashes are then combined bottom up
+    QMap<QString, SumitDirListing> listings;
+    QStringList all_files;
+    list_directory_tree(path, listings, all_files);
+    QStringList sums = sumit_files(all_files, temporary_path);
+    QHash<QString, QString> file_sums;
+    for (int i = 0; i < all_files.count(); i++) {
+        file_sums[all_files[i]] = sums[i];
+    }
+    return directory_tree_hash(path, listings, file_sums);
+}
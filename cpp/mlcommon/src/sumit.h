@@ -18,16 +18,24 @@
 #define SUMIT_H
 
 #include <QString>
+#include <QStringList>
 
 /*
-Computation of hash checksums. Like sha1sum except applies to folders as well as files and automatically caches computations on the local disk: /tmp/sumit.
+Computation of hash checksums. Like sha1sum except applies to folders as well as files and automatically caches computations on the local disk: <temporary_path>/sumit.
 
-In the case of files, outputs the sha1 checksum, equivalent to the output of sha1sum. Local caching is performed (in /tmp/sumit/sha1) so that checksums do not need to be recomputed on subsequent calls with large files. The cache indexing is by device/inode/size/modification_time so there is no problem if files are moved or renamed within the same file system.
+In the case of files, outputs the sha1 checksum, equivalent to the output of sha1sum. Local caching is performed (in a single index, <temporary_path>/sumit/sha1.idx, see sumitindex.h) so that checksums do not need to be recomputed on subsequent calls with large files. The cache indexing is by device/inode/size/modification_time so there is no problem if files are moved or renamed within the same file system.
 
 In the case of directories, outputs a unique sha1 checksum that depends only on the contents of the directory (not the name or location of the directory). The computation depends on the checksum of each and every file within the directory tree, but again checksums do not need to be recomputed for the files in subsequent calls.
 */
 
 QString sumit(const QString& path, int num_bytes, const QString& temporary_path);
+//the sha1 of a file, or of its first num_bytes bytes if num_bytes is not 0, without caching. Large files are read in blocks of several MB on a separate thread, so that reading overlaps with hashing
+QString compute_the_file_hash(const QString& path, qint64 num_bytes);
+//the sha1 of the concatenated sha1 digests of consecutive blocks of block_size bytes (default 4 MB), with the blocks hashed on num_threads threads (default all cores)
+//this is not the sha1 of the file, so it cannot be compared with the checksums in .prv files
+QString compute_the_file_tree_hash(const QString& path, qint64 block_size = 0, int num_threads = 0);
 QString sumit_dir(const QString& path, const QString& temporary_path);
+//the sha1 of each file (empty for files that cannot be read), with a single index lookup for all of them. Files that are not in the index are hashed in parallel
+QStringList sumit_files(const QStringList& paths, const QString& temporary_path);
 
 #endif // SUMIT_H
@@ -0,0 +1,418 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sumitindex.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QDir>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QtEndian>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SUMIT_RECORD_SIZE 56 //4 x 8 bytes key, 20 bytes sha1, 4 bytes check
+#define SUMIT_READ_RECORDS 4096
+#define SUMIT_COMPACT_MIN_RECORDS 10000
+//the number of files kept by compaction, the most recently recorded or used ones
+#define SUMIT_MAX_ENTRIES 500000
+
+namespace {
+
+quint32 record_check(const unsigned char* data)
+{
+    //FNV-1a of the key and sha1
+    quint32 ret = 2166136261u;
+    for (int i = 0; i < SUMIT_RECORD_SIZE - 4; i++) {
+        ret ^= data[i];
+        ret *= 16777619u;
+    }
+    return ret;
+}
+
+void encode_record(unsigned char* data, const SumitFileKey& key, const SumitDigest& sha1)
+{
+    qToLittleEndian(key.device, data);
+    qToLittleEndian(key.inode, data + 8);
+    qToLittleEndian(key.size, data + 16);
+    qToLittleEndian(key.mtime_ns, data + 24);
+    memcpy(data + 32, sha1.bytes, 20);
+    qToLittleEndian(record_check(data), data + 52);
+}
+
+bool decode_record(const unsigned char* data, SumitFileKey* key, SumitDigest* sha1)
+{
+    if (qFromLittleEndian<quint32>(data + 52) != record_check(data))
+        return false;
+    key->device = qFromLittleEndian<quint64>(data);
+    key->inode = qFromLittleEndian<quint64>(data + 8);
+    key->size = qFromLittleEndian<quint64>(data + 16);
+    key->mtime_ns = qFromLittleEndian<quint64>(data + 24);
+    memcpy(sha1->bytes, data + 32, 20);
+    return true;
+}
+
+bool digest_from_hex(const QString& hex, SumitDigest* sha1)
+{
+    QByteArray bytes = QByteArray::fromHex(hex.toLatin1());
+    if (bytes.count() != 20)
+        return false;
+    memcpy(sha1->bytes, bytes.constData(), 20);
+    return true;
+}
+
+QString digest_to_hex(const SumitDigest& sha1)
+{
+    return QString(QByteArray::fromRawData((const char*)sha1.bytes, 20).toHex());
+}
+
+bool write_all(int fd, const unsigned char* data, qint64 num_bytes)
+{
+    while (num_bytes > 0) {
+        ssize_t num = ::write(fd, data, num_bytes);
+        if (num < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += num;
+        num_bytes -= num;
+    }
+    return true;
+}
+}
+
+bool SumitFileKey::operator==(const SumitFileKey& other) const
+{
+    return ((device == other.device) && (inode == other.inode) && (size == other.size) && (mtime_ns == other.mtime_ns));
+}
+
+bool SumitDigest::operator==(const SumitDigest& other) const
+{
+    return (memcmp(bytes, other.bytes, 20) == 0);
+}
+
+uint qHash(const SumitFileKey& key, uint seed)
+{
+    return qHash(key.inode, seed) ^ qHash(key.mtime_ns, seed * 31 + 1) ^ qHash(key.size ^ (key.device << 32), seed * 17 + 2);
+}
+
+class SumitIndexPrivate {
+public:
+    struct Entry {
+        SumitDigest sha1;
+        qint64 seq; //position of its latest record in the log
+    };
+
+    SumitIndex* q;
+    QString log_path;
+    QString lock_path;
+    int fd = -1;
+    int lock_fd = -1;
+    quint64 log_inode = 0;
+    qint64 loaded_bytes = 0;
+    qint64 num_records = 0;
+    QHash<SumitFileKey, Entry> entries;
+    QMutex mutex;
+
+    void refresh();
+    bool reopen_if_replaced();
+    bool lock();
+    void unlock();
+    void append(const QList<SumitFileKey>& keys, const QList<SumitDigest>& sha1s);
+    bool needs_compaction() const;
+    bool compact();
+};
+
+SumitIndex* SumitIndex::instance(const QString& temporary_path)
+{
+    static QMutex s_mutex;
+    static QMap<QString, SumitIndex*> s_instances;
+    QMutexLocker locker(&s_mutex);
+    if (!s_instances.contains(temporary_path))
+        s_instances[temporary_path] = new SumitIndex(temporary_path);
+    return s_instances[temporary_path];
+}
+
+bool SumitIndex::fileKey(const QString& path, SumitFileKey* key)
+{
+    struct stat SS;
+    if (stat(path.toUtf8().data(), &SS) != 0)
+        return false;
+    key->device = SS.st_dev;
+    key->inode = SS.st_ino;
+    key->size = SS.st_size;
+#ifdef __APPLE__
+    key->mtime_ns = (quint64)SS.st_mtimespec.tv_sec * 1000000000 + SS.st_mtimespec.tv_nsec;
+#else
+    key->mtime_ns = (quint64)SS.st_mtim.tv_sec * 1000000000 + SS.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+SumitIndex::SumitIndex(const QString& temporary_path)
+{
+    d = new SumitIndexPrivate;
+    d->q = this;
+    QDir().mkpath(temporary_path + "/sumit");
+    d->log_path = temporary_path + "/sumit/sha1.idx";
+    d->lock_path = temporary_path + "/sumit/sha1.idx.lock";
+    d->lock_fd = ::open(d->lock_path.toUtf8().data(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    QMutexLocker locker(&d->mutex);
+    d->refresh();
+    if (d->needs_compaction())
+        d->compact();
+}
+
+SumitIndex::~SumitIndex()
+{
+    if (d->fd >= 0)
+        ::close(d->fd);
+    if (d->lock_fd >= 0)
+        ::close(d->lock_fd);
+    delete d;
+}
+
+QString SumitIndex::lookup(const SumitFileKey& key)
+{
+    return lookup(QList<SumitFileKey>() << key).value(0);
+}
+
+QStringList SumitIndex::lookup(const QList<SumitFileKey>& keys)
+{
+    QMutexLocker locker(&d->mutex);
+    QStringList ret;
+    bool refreshed = false;
+    QList<SumitFileKey> used_keys;
+    QList<SumitDigest> used_sha1s;
+    for (int i = 0; i < keys.count(); i++) {
+        if ((!refreshed) && (!d->entries.contains(keys[i]))) {
+            //other processes may have added it since we last looked
+            d->refresh();
+            refreshed = true;
+        }
+        auto it = d->entries.constFind(keys[i]);
+        if (it == d->entries.constEnd()) {
+            ret << "";
+            continue;
+        }
+        ret << digest_to_hex(it.value().sha1);
+        //an entry that is still in use but among the older half of what compaction keeps is recorded again, so that it is not evicted
+        if (it.value().seq < d->num_records - SUMIT_MAX_ENTRIES / 2) {
+            used_keys << keys[i];
+            used_sha1s << it.value().sha1;
+        }
+    }
+    if (!used_keys.isEmpty())
+        d->append(used_keys, used_sha1s);
+    return ret;
+}
+
+void SumitIndex::insert(const SumitFileKey& key, const QString& sha1)
+{
+    insert(QList<SumitFileKey>() << key, QStringList(sha1));
+}
+
+void SumitIndex::insert(const QList<SumitFileKey>& keys, const QStringList& sha1s)
+{
+    QMutexLocker locker(&d->mutex);
+    QList<SumitFileKey> new_keys;
+    QList<SumitDigest> new_sha1s;
+    for (int i = 0; i < keys.count(); i++) {
+        SumitDigest sha1;
+        if (!digest_from_hex(sha1s.value(i), &sha1))
+            continue;
+        auto it = d->entries.constFind(keys[i]);
+        if ((it != d->entries.constEnd()) && (it.value().sha1 == sha1))
+            continue;
+        new_keys << keys[i];
+        new_sha1s << sha1;
+    }
+    if (new_keys.isEmpty())
+        return;
+    d->append(new_keys, new_sha1s);
+    if (d->needs_compaction())
+        d->compact();
+}
+
+void SumitIndexPrivate::append(const QList<SumitFileKey>& keys, const QList<SumitDigest>& sha1s)
+{
+    //mutex must be locked
+    QByteArray records(keys.count() * SUMIT_RECORD_SIZE, 0);
+    for (int i = 0; i < keys.count(); i++) {
+        encode_record((unsigned char*)records.data() + i * SUMIT_RECORD_SIZE, keys[i], sha1s[i]);
+        Entry E;
+        E.sha1 = sha1s[i];
+        E.seq = num_records; //until the record is read back
+        entries[keys[i]] = E;
+    }
+    if (!lock())
+        return;
+    reopen_if_replaced();
+    if (fd >= 0) {
+        struct stat SS;
+        if ((fstat(fd, &SS) == 0) && (SS.st_size % SUMIT_RECORD_SIZE != 0)) {
+            //a writer crashed in the middle of a record; drop it so that the records stay aligned
+            if (ftruncate(fd, SS.st_size - SS.st_size % SUMIT_RECORD_SIZE) != 0)
+                qWarning() << "Unable to truncate" << log_path;
+        }
+        if (!write_all(fd, (const unsigned char*)records.constData(), records.count()))
+            qWarning() << "Unable to append to" << log_path;
+    }
+    refresh();
+    unlock();
+}
+
+bool SumitIndexPrivate::needs_compaction() const
+{
+    if (num_records < SUMIT_COMPACT_MIN_RECORDS)
+        return false;
+    //mostly repeated records, or too many files
+    return ((num_records > 2 * entries.count()) || (entries.count() > SUMIT_MAX_ENTRIES + SUMIT_MAX_ENTRIES / 4));
+}
+
+bool SumitIndex::compact()
+{
+    QMutexLocker locker(&d->mutex);
+    return d->compact();
+}
+
+bool SumitIndexPrivate::reopen_if_replaced()
+{
+    struct stat SS;
+    if (stat(log_path.toUtf8().data(), &SS) == 0) {
+        if ((fd >= 0) && ((quint64)SS.st_ino == log_inode))
+            return false;
+    }
+    if (fd >= 0)
+        ::close(fd);
+    fd = ::open(log_path.toUtf8().data(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        //read-only access is enough for lookups
+        fd = ::open(log_path.toUtf8().data(), O_RDONLY | O_CLOEXEC);
+    }
+    log_inode = 0;
+    if ((fd >= 0) && (fstat(fd, &SS) == 0))
+        log_inode = SS.st_ino;
+    //the log was compacted (or created): read it again from the start, dropping what compaction evicted
+    entries.clear();
+    loaded_bytes = 0;
+    num_records = 0;
+    return true;
+}
+
+void SumitIndexPrivate::refresh()
+{
+    reopen_if_replaced();
+    if (fd < 0)
+        return;
+    struct stat SS;
+    if (fstat(fd, &SS) != 0)
+        return;
+    qint64 end = SS.st_size - SS.st_size % SUMIT_RECORD_SIZE;
+    QByteArray buf;
+    while (loaded_bytes < end) {
+        qint64 num_bytes = qMin(end - loaded_bytes, (qint64)SUMIT_RECORD_SIZE * SUMIT_READ_RECORDS);
+        buf.resize(num_bytes);
+        ssize_t num_read = pread(fd, buf.data(), num_bytes, loaded_bytes);
+        if (num_read < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        num_read -= num_read % SUMIT_RECORD_SIZE;
+        if (num_read == 0)
+            return;
+        const unsigned char* data = (const unsigned char*)buf.constData();
+        SumitFileKey key;
+        Entry E;
+        for (qint64 i = 0; i < num_read; i += SUMIT_RECORD_SIZE) {
+            if (decode_record(data + i, &key, &E.sha1)) {
+                E.seq = num_records;
+                entries[key] = E;
+                num_records++;
+            }
+        }
+        loaded_bytes += num_read;
+    }
+}
+
+bool SumitIndexPrivate::lock()
+{
+    if (lock_fd < 0)
+        return false;
+    while (flock(lock_fd, LOCK_EX) != 0) {
+        if (errno != EINTR)
+            return false;
+    }
+    return true;
+}
+
+void SumitIndexPrivate::unlock()
+{
+    flock(lock_fd, LOCK_UN);
+}
+
+bool SumitIndexPrivate::compact()
+{
+    if (!lock())
+        return false;
+    refresh();
+    QString tmp_path = log_path + ".tmp";
+    int tmp_fd = ::open(tmp_path.toUtf8().data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (tmp_fd < 0) {
+        unlock();
+        return false;
+    }
+    //keep the latest record of each file (device and inode): an older one is for contents that have since been replaced. Of those, keep the SUMIT_MAX_ENTRIES most recent, in their original order
+    typedef QHash<SumitFileKey, Entry>::const_iterator EntryIterator;
+    QHash<QPair<quint64, quint64>, EntryIterator> latest;
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        QPair<quint64, quint64> file(it.key().device, it.key().inode);
+        auto it2 = latest.find(file);
+        if (it2 == latest.end())
+            latest.insert(file, it);
+        else if (it2.value().value().seq < it.value().seq)
+            it2.value() = it;
+    }
+    QList<QPair<qint64, EntryIterator> > kept;
+    for (auto it = latest.constBegin(); it != latest.constEnd(); ++it) {
+        kept << qMakePair(it.value().value().seq, it.value());
+    }
+    std::sort(kept.begin(), kept.end(), [](const QPair<qint64, EntryIterator>& a, const QPair<qint64, EntryIterator>& b) { return a.first < b.first; });
+    int first = qMax(0, kept.count() - SUMIT_MAX_ENTRIES);
+    QByteArray records((kept.count() - first) * SUMIT_RECORD_SIZE, 0);
+    for (int i = first; i < kept.count(); i++) {
+        encode_record((unsigned char*)records.data() + (i - first) * SUMIT_RECORD_SIZE, kept[i].second.key(), kept[i].second.value().sha1);
+    }
+    bool ok = write_all(tmp_fd, (const unsigned char*)records.constData(), records.count());
+    ok = ok && (fsync(tmp_fd) == 0);
+    ::close(tmp_fd);
+    ok = ok && (rename(tmp_path.toUtf8().data(), log_path.toUtf8().data()) == 0);
+    if (!ok)
+        unlink(tmp_path.toUtf8().data());
+    refresh();
+    unlock();
+    return ok;
+}
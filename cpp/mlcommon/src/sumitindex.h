@@ -0,0 +1,70 @@
+/*
+ * Copyright 2016-2017 Flatiron Institute, Simons Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SUMITINDEX_H
+#define SUMITINDEX_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/*
+The checksum cache of sumit: a single file <temporary_path>/sumit/sha1.idx shared by all processes using the same temporary path.
+
+The file is an append-only log of fixed-size records (device, inode, size, modification time in ns, sha1), each with its own check value so that a record torn by a crash is ignored. Every process keeps the records in a hash map and only reads what was appended since its last look, so a lookup of a known file costs no system calls beyond the stat of the file itself. Appends and compaction are serialized between processes with flock on sha1.idx.lock. Compaction rewrites the log to a temporary file and renames it over the old one; other processes notice the new inode and reload. It keeps only the latest record of each device and inode (older ones describe contents that were replaced), and of those only the 500000 most recent. A file whose record gets old while it is still being looked up is recorded again, so eviction drops the files that have not been used for the longest time, which include the deleted ones.
+*/
+
+struct SumitFileKey {
+    quint64 device = 0;
+    quint64 inode = 0;
+    quint64 size = 0;
+    quint64 mtime_ns = 0;
+
+    bool operator==(const SumitFileKey& other) const;
+};
+uint qHash(const SumitFileKey& key, uint seed = 0);
+
+struct SumitDigest {
+    unsigned char bytes[20]; //raw sha1
+
+    bool operator==(const SumitDigest& other) const;
+};
+
+class SumitIndexPrivate;
+class SumitIndex {
+public:
+    friend class SumitIndexPrivate;
+    ///The index under temporary_path, opened on first use and shared by the threads of the process
+    static SumitIndex* instance(const QString& temporary_path);
+
+    ///Identifies the current contents of a file by device, inode, size and modification time. Returns false if the file does not exist
+    static bool fileKey(const QString& path, SumitFileKey* key);
+
+    ///The sha1 (hex) recorded for the key, or an empty string
+    QString lookup(const SumitFileKey& key);
+    QStringList lookup(const QList<SumitFileKey>& keys);
+    void insert(const SumitFileKey& key, const QString& sha1);
+    void insert(const QList<SumitFileKey>& keys, const QStringList& sha1s);
+
+    ///Rewrite the log with a single record per file, dropping the least recently used beyond the limit. Done automatically when the log is mostly repeated records or holds too many files
+    bool compact();
+
+private:
+    SumitIndex(const QString& temporary_path);
+    ~SumitIndex();
+    SumitIndexPrivate* d;
+};
+
+#endif // SUMITINDEX_H
@@ -172,29 +172,20 @@ QJsonObject handle_request_queue_process(QString processor_name, QString process
         }
     }
 
+    //all the input prv objects are located together, in a single pass over the search paths
+    QList<QJsonObject> prv_objects;
+    QStringList prv_keys;
     foreach (QString key, ikeys) {
         if (PP.inputs.contains(key)) {
             if (inputs[key].isObject()) {
-                QJsonObject prv_object = inputs[key].toObject();
-                QString path0 = locate_prv(prv_object);
-                if (path0.isEmpty()) {
-                    response["success"] = false;
-                    response["error"] = QString("Unable to locate prv for key=%1. (original_path=%2,checksum=%3)").arg(key).arg(prv_object["original_path"].toString()).arg(prv_object["original_checksum"].toString());
-                    return response;
-                }
-                args << QString("--%1=%2").arg(key).arg(path0);
+                prv_objects << inputs[key].toObject();
+                prv_keys << key;
             }
             else if (inputs[key].isArray()) {
                 QJsonArray prv_object_list = inputs[key].toArray();
                 for (int aa = 0; aa < prv_object_list.count(); aa++) {
-                    QJsonObject prv_object = prv_object_list[aa].toObject();
-                    QString path0 = locate_prv(prv_object);
-                    if (path0.isEmpty()) {
-                        response["success"] = false;
-                        response["error"] = QString("Unable to locate prv for key=%1. (original_path=%2,checksum=%3)").arg(key).arg(prv_object["original_path"].toString()).arg(prv_object["original_checksum"].toString());
-                        return response;
-                    }
-                    args << QString("--%1=%2").arg(key).arg(path0);
+                    prv_objects << prv_object_list[aa].toObject();
+                    prv_keys << key;
                 }
             }
             else {
@@ -209,6 +200,15 @@ QJsonObject handle_request_queue_process(QString processor_name, QString process
             return response;
         }
     }
+    QStringList prv_paths = locate_prv_batch(prv_objects);
+    for (int i = 0; i < prv_objects.count(); i++) {
+        if (prv_paths[i].isEmpty()) {
+            response["success"] = false;
+            response["error"] = QString("Unable to locate prv for key=%1. (original_path=%2,checksum=%3)").arg(prv_keys[i]).arg(prv_objects[i]["original_path"].toString()).arg(prv_objects[i]["original_checksum"].toString());
+            return response;
+        }
+        args << QString("--%1=%2").arg(prv_keys[i]).arg(prv_paths[i]);
+    }
 
     foreach (QString key, pkeys) {
         if (PP.parameters.contains(key)) {
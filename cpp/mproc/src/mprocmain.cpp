@@ -564,25 +564,16 @@ QStringList get_local_search_paths_2()
     return local_search_paths;
 }
 
-QString resolve_file_name_prv(QString fname)
+bool read_prv_file(QString fname, QJsonObject* obj)
 {
-    if (fname.endsWith(".prv")) {
-        QString txt = TextFile::read(fname);
-        QJsonParseError err;
-        QJsonObject obj = QJsonDocument::fromJson(txt.toUtf8(), &err).object();
-        if (err.error != QJsonParseError::NoError) {
-            qCWarning(MP) << "Error parsing .prv file: " + fname;
-            return "";
-        }
-        QString path0 = MLUtil::locatePrv(obj, get_local_search_paths_2());
-        if (path0.isEmpty()) {
-            qCWarning(MP) << "Unable to locate prv file originally at: " + obj["original_path"].toString();
-            return "";
-        }
-        return path0;
+    QString txt = TextFile::read(fname);
+    QJsonParseError err;
+    *obj = QJsonDocument::fromJson(txt.toUtf8(), &err).object();
+    if (err.error != QJsonParseError::NoError) {
+        qCWarning(MP) << "Error parsing .prv file: " + fname;
+        return false;
     }
-    else
-        return fname;
+    return true;
 }
 
 QVariantMap resolve_file_names_in_inputs(const MLProcessor& MLP, const QVariantMap& parameters_in, bool* success, QString* errstr)
@@ -590,26 +581,45 @@ QVariantMap resolve_file_names_in_inputs(const MLProcessor& MLP, const QVariantM
     (*success) = true;
     QVariantMap parameters = parameters_in;
 
+    //the .prv inputs are located together, in a single pass over the search paths
+    QStringList prv_fnames;
+    QList<QJsonObject> prv_objects;
     foreach (MLParameter P, MLP.inputs) {
         QStringList list = MLUtil::toStringList(parameters[P.name]);
-        if (list.count() == 1) {
-            parameters[P.name] = resolve_file_name_prv(list[0]);
-            if ((!list[0].isEmpty()) && (parameters[P.name].toString().isEmpty())) {
-                (*success) = false;
-                *errstr = "Error resolving prv: " + list[0];
-                return QVariantMap();
+        foreach (QString str, list) {
+            if ((str.endsWith(".prv")) && (!prv_fnames.contains(str))) {
+                QJsonObject obj;
+                if (!read_prv_file(str, &obj)) {
+                    (*success) = false;
+                    *errstr = "Error resolving prv: " + str;
+                    return QVariantMap();
+                }
+                prv_fnames << str;
+                prv_objects << obj;
             }
         }
+    }
+    QStringList prv_paths = MLUtil::locatePrvBatch(prv_objects, get_local_search_paths_2());
+    QMap<QString, QString> resolved;
+    for (int i = 0; i < prv_fnames.count(); i++) {
+        if (prv_paths[i].isEmpty()) {
+            qCWarning(MP) << "Unable to locate prv file originally at: " + prv_objects[i]["original_path"].toString();
+            (*success) = false;
+            *errstr = "Error resolving prv: " + prv_fnames[i];
+            return QVariantMap();
+        }
+        resolved[prv_fnames[i]] = prv_paths[i];
+    }
+
+    foreach (MLParameter P, MLP.inputs) {
+        QStringList list = MLUtil::toStringList(parameters[P.name]);
+        if (list.count() == 1) {
+            parameters[P.name] = resolved.value(list[0], list[0]);
+        }
         else {
             QVariantList list2;
             foreach (QString str, list) {
-                QString str2 = resolve_file_name_prv(str);
-                if ((!str.isEmpty()) && (str2.isEmpty())) {
-                    (*success) = false;
-                    *errstr = "Error resolving prv: " + str;
-                    return QVariantMap();
-                }
-                list2 << str2;
+                list2 << resolved.value(str, str);
             }
             parameters[P.name] = list2;
         }